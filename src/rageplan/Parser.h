@@ -45,6 +45,22 @@ namespace PARSER{
         int treeKnowledge = 1;
         int rolloutKnowledge = 1;
         bool fTable = 0;
+        int threads = 1;
+        double planningTime = 0;
+        bool treeParallel = 0;
+        bool reuseTree = 0;
+        int benchmark = 0;
+        double wideningK = 0;
+        double wideningAlpha = 0.5;
+        double earlyStop = 0;
+        bool weightedBeliefs = 0;
+        bool compactBeliefs = 0;
+        double kldError = 0;
+        int filterParticles = 0;
+        double filterTime = 0;
+        int factoredParticles = 0;
+        bool packBeliefs = 0;
+        bool analyticPGS = 0;
     };
     
     void parseCommandLine(char ** argv, int argc, COMMAND_LINE& cl){        
@@ -112,6 +128,70 @@ namespace PARSER{
                 cout << std::left << std::setw(20) << "--rolloutKnowledge";
                 cout << std::left << std::setw(100) << "Type of Rollout policy (0=Pure, 1=Legal, 2=Smart, 3=PGS)" << endl;
                 
+                cout << std::setw(3) << "";
+                cout << std::left << std::setw(20) << "--threads";
+                cout << std::left << std::setw(100) << "No. of parallel search threads" << endl;
+                
+                cout << std::setw(3) << "";
+                cout << std::left << std::setw(20) << "--planningTime";
+                cout << std::left << std::setw(100) << "Search deadline per action in seconds (0 = no deadline)" << endl;
+                
+                cout << std::setw(3) << "";
+                cout << std::left << std::setw(20) << "--treeParallel";
+                cout << std::left << std::setw(100) << "Threads share one search tree (0 = root-parallel, 1 = tree-parallel)" << endl;
+                
+                cout << std::setw(3) << "";
+                cout << std::left << std::setw(20) << "--reuseTree";
+                cout << std::left << std::setw(100) << "Keep the subtree of the executed action and observation as the next root" << endl;
+                
+                cout << std::setw(3) << "";
+                cout << std::left << std::setw(20) << "--wideningK";
+                cout << std::left << std::setw(100) << "Progressive widening k, new observation branches while < k*N^alpha (0 = off)" << endl;
+                
+                cout << std::setw(3) << "";
+                cout << std::left << std::setw(20) << "--wideningAlpha";
+                cout << std::left << std::setw(100) << "Progressive widening exponent alpha" << endl;
+                
+                cout << std::setw(3) << "";
+                cout << std::left << std::setw(20) << "--earlyStop";
+                cout << std::left << std::setw(100) << "Stop the search once the best root action is separated at confidence 1-delta (delta, 0 = off)" << endl;
+                
+                cout << std::setw(3) << "";
+                cout << std::left << std::setw(20) << "--weightedBeliefs";
+                cout << std::left << std::setw(100) << "Weighted particle filter beliefs with systematic resampling (0 = rejection, 1 = weighted)" << endl;
+                
+                cout << std::setw(3) << "";
+                cout << std::left << std::setw(20) << "--compactBeliefs";
+                cout << std::left << std::setw(100) << "Merge duplicate particles after each update (0 = off, 1 = on)" << endl;
+                
+                cout << std::setw(3) << "";
+                cout << std::left << std::setw(20) << "--kldError";
+                cout << std::left << std::setw(100) << "Adaptive no. of root particles by KLD-sampling with this error bound (0 = off)" << endl;
+                
+                cout << std::setw(3) << "";
+                cout << std::left << std::setw(20) << "--filterParticles";
+                cout << std::left << std::setw(100) << "Particle filter update: step root particles until this many match the observation (0 = off)" << endl;
+                
+                cout << std::setw(3) << "";
+                cout << std::left << std::setw(20) << "--filterTime";
+                cout << std::left << std::setw(100) << "Time budget in seconds for the particle filter update (0 = none, attempts stay bounded)" << endl;
+                
+                cout << std::setw(3) << "";
+                cout << std::left << std::setw(20) << "--factoredParticles";
+                cout << std::left << std::setw(100) << "Factored beliefs: particles kept per node, the rest is drawn from marginals (0 = off, approximate, ignored by simulators without factors)" << endl;
+                
+                cout << std::setw(3) << "";
+                cout << std::left << std::setw(20) << "--packBeliefs";
+                cout << std::left << std::setw(100) << "Keep the root belief bit-packed between updates (hotel and assembly)" << endl;
+                
+                cout << std::setw(3) << "";
+                cout << std::left << std::setw(20) << "--analyticPGS";
+                cout << std::left << std::setw(100) << "PGS rollouts score actions by expected PGS change, without simulating them (hotel, assembly, mobipick)" << endl;
+                
+                cout << std::setw(3) << "";
+                cout << std::left << std::setw(20) << "--benchmark";
+                cout << std::left << std::setw(100) << "1 = compare serial, root- and tree-parallel search, 2 = time PGS with analyticPGS off and on" << endl;
+                
                 exit(0);
             }
             if(param == "--about"){
@@ -153,6 +233,38 @@ namespace PARSER{
                 cl.rolloutKnowledge = stoi(value);
             else if(param == "--fTable")
                 cl.fTable = stoi(value);
+            else if(param == "--threads")
+                cl.threads = stoi(value);
+            else if(param == "--planningTime")
+                cl.planningTime = stod(value);
+            else if(param == "--treeParallel")
+                cl.treeParallel = stoi(value);
+            else if(param == "--reuseTree")
+                cl.reuseTree = stoi(value);
+            else if(param == "--wideningK")
+                cl.wideningK = stod(value);
+            else if(param == "--wideningAlpha")
+                cl.wideningAlpha = stod(value);
+            else if(param == "--earlyStop")
+                cl.earlyStop = stod(value);
+            else if(param == "--weightedBeliefs")
+                cl.weightedBeliefs = stoi(value);
+            else if(param == "--compactBeliefs")
+                cl.compactBeliefs = stoi(value);
+            else if(param == "--kldError")
+                cl.kldError = stod(value);
+            else if(param == "--filterParticles")
+                cl.filterParticles = stoi(value);
+            else if(param == "--filterTime")
+                cl.filterTime = stod(value);
+            else if(param == "--factoredParticles")
+                cl.factoredParticles = stoi(value);
+            else if(param == "--packBeliefs")
+                cl.packBeliefs = stoi(value);
+            else if(param == "--analyticPGS")
+                cl.analyticPGS = stoi(value);
+            else if(param == "--benchmark")
+                cl.benchmark = stoi(value);
             else
                 cout << "Unrecognized parameter \"" << param << "\"" << endl;
         }
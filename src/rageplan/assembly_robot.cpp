@@ -7,13 +7,6 @@
 using namespace std;
 using namespace UTILS;
 
-void ASSEMBLY_ROBOT_STATE::activateFeature(int feature, bool status){
-    if(feature >= NumTypes && feature < containers.size()){
-        containers[feature - NumTypes].active = status;
-    }
-}
-
-
 /* Build Ftable mapping every action to its affected feature/object */
 /*
     In Mobipick, actions afforded by objects are: pick object, identify object
@@ -113,6 +106,143 @@ STATE* ASSEMBLY_ROBOT::Copy(const STATE& state) const
     return newstate;
 }
 
+// Hash of the variables that differ between particles, see Equal
+std::size_t ASSEMBLY_ROBOT::Hash(const STATE& state) const
+{
+    const ASSEMBLY_ROBOT_STATE& rState = safe_cast<const ASSEMBLY_ROBOT_STATE&>(state);
+    std::size_t hash = 1;
+    HashCombine(hash, rState.workerState.activity);
+    HashCombine(hash, rState.workerState.pose);
+    HashCombine(hash, rState.workerState.outcome);
+    HashCombine(hash, rState.workerState.truck);
+    HashCombine(hash, rState.workerState.glueType);
+    for(const auto& t : rState.workerState.trucks){
+        HashCombine(hash, t.type);
+        HashCombine(hash, t.complete);
+        for(const auto& p : t.parts)
+            HashCombine(hash, p.assembled);
+    }
+    HashCombine(hash, rState.missing_glue);
+    HashCombine(hash, rState.available);
+    for(const auto& o : rState.po_truck)
+        HashCombine(hash, o.LikelihoodT0);
+    for(const auto& c : rState.containers){
+        HashCombine(hash, c.needed);
+        HashCombine(hash, c.LikelihoodEmpty);
+    }
+    for(int s : rState.storage)
+        HashCombine(hash, s);
+    return hash;
+}
+
+bool ASSEMBLY_ROBOT::Equal(const STATE& state1, const STATE& state2) const
+{
+    const ASSEMBLY_ROBOT_STATE& s1 = safe_cast<const ASSEMBLY_ROBOT_STATE&>(state1);
+    const ASSEMBLY_ROBOT_STATE& s2 = safe_cast<const ASSEMBLY_ROBOT_STATE&>(state2);
+    return s1.workerState == s2.workerState && s1.missing_glue == s2.missing_glue &&
+        s1.NumTypes == s2.NumTypes && s1.available == s2.available &&
+        s1.po_truck == s2.po_truck && s1.containers == s2.containers &&
+        s1.storage == s2.storage;
+}
+
+// KLD bins: truck types and the true part, storage and glue status
+std::size_t ASSEMBLY_ROBOT::Discretise(const STATE& state) const
+{
+    const ASSEMBLY_ROBOT_STATE& rState = safe_cast<const ASSEMBLY_ROBOT_STATE&>(state);
+    std::size_t bin = 1;
+    HashCombine(bin, rState.workerState.truck);
+    HashCombine(bin, rState.workerState.glueType);
+    for(const auto& t : rState.workerState.trucks){
+        HashCombine(bin, t.type);
+        for(const auto& p : t.parts)
+            HashCombine(bin, p.assembled);
+    }
+    for(int s : rState.storage)
+        HashCombine(bin, s > 0);
+    HashCombine(bin, rState.missing_glue);
+    return bin;
+}
+
+/* Packed particle: worker activity, truck types and parts as bit fields,
+ * storage as ints and beliefs as doubles. Names, costs, the parts of each
+ * truck and the unused low flags never change and come from the particle
+ * Unpack overwrites.
+ */
+bool ASSEMBLY_ROBOT::Pack(const STATE& state, BIT_WRITER& bits, vector<double>& probs) const
+{
+    const ASSEMBLY_ROBOT_STATE& rState = safe_cast<const ASSEMBLY_ROBOT_STATE&>(state);
+
+    bits.PutInt(rState.workerState.activity);
+    bits.PutInt(rState.workerState.pose);
+    bits.PutInt(rState.workerState.outcome);
+    bits.PutInt(rState.workerState.truck);
+    bits.PutInt(rState.workerState.glueType);
+    for(const auto& t : rState.workerState.trucks){
+        bits.Put(t.type, 8);
+        bits.Put(t.needsGlue, 1);
+        bits.Put(t.complete, 1);
+        for(const auto& p : t.parts)
+            bits.Put(p.assembled, 1);
+        probs.push_back(t.percentageComplete);
+    }
+    bits.Put(rState.missing_glue, 1);
+    bits.Put(rState.available, 1);
+
+    for(const auto& o : rState.po_truck){
+        bits.Put(o.assumedType, 1);
+        probs.push_back(o.ProbT0);
+        probs.push_back(o.LikelihoodT0);
+        probs.push_back(o.LikelihoodNotT0);
+    }
+    for(const auto& e : rState.containers){
+        bits.Put(e.needed, 1);
+        bits.Put(e.empty, 1);
+        probs.push_back(e.LikelihoodEmpty);
+        probs.push_back(e.LikelihoodNotEmpty);
+        probs.push_back(e.ProbEmpty);
+    }
+    for(int s : rState.storage)
+        bits.PutInt(s);
+    return true;
+}
+
+void ASSEMBLY_ROBOT::Unpack(BIT_READER& bits, const double* probs, STATE& state) const
+{
+    ASSEMBLY_ROBOT_STATE& rState = safe_cast<ASSEMBLY_ROBOT_STATE&>(state);
+
+    rState.workerState.activity = bits.GetInt();
+    rState.workerState.pose = bits.GetInt();
+    rState.workerState.outcome = bits.GetInt();
+    rState.workerState.truck = bits.GetInt();
+    rState.workerState.glueType = bits.GetInt();
+    for(auto& t : rState.workerState.trucks){
+        t.type = bits.Get(8);
+        t.needsGlue = bits.Get(1);
+        t.complete = bits.Get(1);
+        for(auto& p : t.parts)
+            p.assembled = bits.Get(1);
+        t.percentageComplete = *probs++;
+    }
+    rState.missing_glue = bits.Get(1);
+    rState.available = bits.Get(1);
+
+    for(auto& o : rState.po_truck){
+        o.assumedType = bits.Get(1);
+        o.ProbT0 = *probs++;
+        o.LikelihoodT0 = *probs++;
+        o.LikelihoodNotT0 = *probs++;
+    }
+    for(auto& e : rState.containers){
+        e.needed = bits.Get(1);
+        e.empty = bits.Get(1);
+        e.LikelihoodEmpty = *probs++;
+        e.LikelihoodNotEmpty = *probs++;
+        e.ProbEmpty = *probs++;
+    }
+    for(int& s : rState.storage)
+        s = bits.GetInt();
+}
+
 void ASSEMBLY_ROBOT::Validate(const STATE& state) const
 {
     const ASSEMBLY_ROBOT_STATE& robotState = safe_cast<const ASSEMBLY_ROBOT_STATE&>(state);
@@ -135,6 +265,7 @@ STATE* ASSEMBLY_ROBOT::CreateStartState() const
     state->missing_glue = true;
     state->NumTypes = NumTypes;
     
+    state->po_truck.clear(); //Pooled states keep their old vectors
     for(int i=0; i < NumObjects; i++){
         ASSEMBLY_ROBOT_STATE::PO_OBJ po_truck;
         
@@ -189,9 +320,6 @@ STATE* ASSEMBLY_ROBOT::CreateStartState() const
         e.LikelihoodNotEmpty = 1.0;
         e.ProbEmpty = 0.5;
         
-        //IRE
-        e.active = true;
-        
         //Add PO object
         state->containers.push_back(e);        
     }
@@ -231,18 +359,21 @@ bool ASSEMBLY_ROBOT::StepPGS(STATE& state, int action,
    double scale = 10.0;
     double r = 0.0;
     double r2 = 0.0;
-    STATE* oldstate = Copy(state);
+    ASSEMBLY_ROBOT_STATE& rState = safe_cast<ASSEMBLY_ROBOT_STATE&>(state);
+
+    //Old potential and the old terms of PGS_RO, taken before the step instead of copying the state
+    r2 = PGS(state);
+    PGS_BEFORE before;
+    PGSBefore(rState, action, before);
 
     bool terminal = StepNormal(state, action, observation, reward);
 
     // Potential-based reward bonus
     //if(!terminal){//Not terminal or out of bounds
-        r2 = PGS(*oldstate);
-        r = PGS_RO(*oldstate, state, action, r2); //PGS(state);
+        r = PGSAfter(rState, action, before, r2); //PGS(state);
         
         reward += PGSAlpha*r - PGSAlpha*r2;        
     //}
-    FreeState(oldstate);
 
     return terminal;
 }
@@ -568,35 +699,50 @@ bool ASSEMBLY_ROBOT::LocalMove(STATE& state, const HISTORY& history, int stepObs
  * Simplified PGS point count by using only the specific action changes
  */
 double ASSEMBLY_ROBOT::PGS_RO(STATE& oldstate, STATE& state, int action, double oldpgs) const
+{
+	PGS_BEFORE before;
+	PGSBefore(safe_cast<ASSEMBLY_ROBOT_STATE&>(oldstate), action, before);
+	return PGSAfter(safe_cast<ASSEMBLY_ROBOT_STATE&>(state), action, before, oldpgs);
+}
+
+/* Old-state terms of PGS_RO */
+void ASSEMBLY_ROBOT::PGSBefore(const ASSEMBLY_ROBOT_STATE& oldRState, int action, PGS_BEFORE& before) const
+{
+    before.points = 0.0;
+
+	//3. Remove point if container status changed
+	if(action >= A_BRING_PARTS){
+        int part = action - A_BRING_PARTS;
+        if(oldRState.containers[part].needed){
+            before.points += PGS_notgoal;            
+        }
+    }
+
+    //4. Truck type uncertainty, the worker may move on to the next truck during the step
+    before.truck = oldRState.workerState.truck;
+    before.truckUncertain = action == A_INSPECT_TRUCK && !BinEntropyCheck(oldRState.po_truck[before.truck].ProbT0);
+}
+
+/* PGS_RO from the new state and the terms taken before the step */
+double ASSEMBLY_ROBOT::PGSAfter(const ASSEMBLY_ROBOT_STATE& rState, int action, const PGS_BEFORE& before, double oldpgs) const
 {
     double points = 0.0;
-	double oldpoints = 0.0;
-	
-	//1. Cast to local state
-	ASSEMBLY_ROBOT_STATE& rState = safe_cast<ASSEMBLY_ROBOT_STATE&>(state);
-	ASSEMBLY_ROBOT_STATE& oldRState = safe_cast<ASSEMBLY_ROBOT_STATE&>(oldstate);
+	double oldpoints = before.points;
 	      
     //2. +1 for truck assembled
-    int t = 0;
 	if(rState.workerState.activity == worker.A_GLUE && rState.workerState.outcome == worker.O_OK){
         points += PGS_goal;
         oldpoints += PGS_uncertain;
 	}
-	
-	//3. Remove point if container status changed
-	if(action >= A_BRING_PARTS){
-        int part = action - A_BRING_PARTS;
-        if(oldRState.containers[part].needed){
-            oldpoints += PGS_notgoal;            
-        }
-    }
 
     //4. Remove point if truck uncertainty is lifted
     if(action == A_INSPECT_TRUCK){
         int truck = rState.workerState.truck;
         if( !BinEntropyCheck(rState.po_truck[truck].ProbT0) ) points += PGS_uncertain;
 
-        if( !BinEntropyCheck(oldRState.po_truck[truck].ProbT0) ) oldpoints += PGS_uncertain;
+        //Only the current truck is inspected, any other one kept its old type estimate
+        bool oldUncertain = truck == before.truck ? before.truckUncertain : !BinEntropyCheck(rState.po_truck[truck].ProbT0);
+        if( oldUncertain ) oldpoints += PGS_uncertain;
     }
 
 
@@ -668,18 +814,22 @@ double ASSEMBLY_ROBOT::PGS(STATE& state) const
 void ASSEMBLY_ROBOT::GeneratePGS(const STATE& state, const HISTORY& history,
                          vector<int>& legal, const STATUS& status) const
 {
-    static vector<int> acts;
+    static thread_local vector<int> acts;
 	acts.clear();
-	STATE * newstate;
-	STATE * oldstate = Copy(state);
 	PGSLegal(state, history, acts, status);
 	int numLegal = acts.size();
 	
 	double pgs_values[numLegal]; //pgs_values[i] <-- legalMove[i]
+
+	//Score actions from the state alone, PGS(state) is the same for all of them
+	if(Knowledge.AnalyticPGS && PGSDeltas(state, acts, pgs_values)){
+		AddBestPGS(acts, pgs_values, legal);
+		return;
+	}
+
+	STATE * newstate;
+	STATE * oldstate = Copy(state);
 	double pgs_state = PGS(*oldstate);
-		
-	int max_p = -1;
-	double max_v = -Infinity;	
 	
 	int observation;
 	double reward;
@@ -702,16 +852,43 @@ void ASSEMBLY_ROBOT::GeneratePGS(const STATE& state, const HISTORY& history,
 	}
 	
 	FreeState(oldstate);
-	max_p = std::distance(pgs_values, max_element(pgs_values, pgs_values+numLegal));
-	max_v = pgs_values[max_p];
-	assert(max_p > -1);
-	
-	legal.push_back(acts[max_p]); //Add best action to return vector
-	// Add other maxima
-	for(int i=0; i<numLegal; i++){
-		if(i != max_p && pgs_values[i] == max_v)
-            legal.push_back(acts[i]);
-	}
+	AddBestPGS(acts, pgs_values, legal); //Best action first, then the other maxima
+}
+
+/* Expected PGS_RO change of each action, over the observations it can return.
+ * Worker progress during the step (truck completion) is left out, it does not
+ * depend on the robot action
+ */
+bool ASSEMBLY_ROBOT::PGSDeltas(const STATE& state, const vector<int>& actions, double* deltas) const
+{
+    const ASSEMBLY_ROBOT_STATE& rState = safe_cast<const ASSEMBLY_ROBOT_STATE&>(state);
+    const auto& truck = rState.po_truck[rState.workerState.truck];
+
+    for(int i=0; i < actions.size(); i++){
+        int action = actions[i];
+        double delta = 0.0;
+
+        //3. Bringing a needed part removes its neg. point, whatever the outcome
+        if(action >= A_BRING_PARTS){
+            if(rState.containers[action - A_BRING_PARTS].needed)
+                delta -= PGS_notgoal;
+        }
+        //4. Truck type uncertainty, see InspectObject
+        else if(action == A_INSPECT_TRUCK){
+            double efficiency = PERCEIVE_ACC;
+            if(rState.workerState.trucks[rState.workerState.truck].percentageComplete < 50)
+                efficiency = 0.5;
+
+            int trueType = rState.workerState.trucks[rState.workerState.truck].type;
+            double pT0 = trueType == 0 ? efficiency : 1 - efficiency; //p(obs = 0)
+            double uncertain = pT0 * !BinEntropyCheck(BinaryPosterior(truck.LikelihoodT0, truck.LikelihoodNotT0, efficiency, true))
+                            + (1 - pT0) * !BinEntropyCheck(BinaryPosterior(truck.LikelihoodT0, truck.LikelihoodNotT0, efficiency, false));
+            delta = PGS_uncertain * (uncertain - !BinEntropyCheck(truck.ProbT0));
+        }
+
+        deltas[i] = delta;
+    }
+    return true;
 }
 
 /*
@@ -736,7 +913,7 @@ void ASSEMBLY_ROBOT::PGSLegal(const STATE& state, const HISTORY& history,
     
     //Selectively allow restocking containers (but always allow scanning)
     for(int o=0; o < NumContainers; o++){        
-        if(rState.containers[o].active){
+        if(IsActive(o + NumTypes)){
             //legal.push_back(A_INSPECT_CONTAINER + o);
             legal.push_back(A_BRING_PARTS + o);
         }
@@ -88,6 +88,11 @@ public:
         double LikelihoodT0;
         double LikelihoodNotT0;
         bool assumedType;
+
+        bool operator==(const PO_OBJ& o) const{
+            return ProbT0 == o.ProbT0 && LikelihoodT0 == o.LikelihoodT0 &&
+                LikelihoodNotT0 == o.LikelihoodNotT0 && assumedType == o.assumedType;
+        }
     };
     vector<PO_OBJ> po_truck;
     
@@ -110,9 +115,15 @@ public:
         double LikelihoodEmpty;
         double LikelihoodNotEmpty;
         double ProbEmpty;
-        
-        //IRE
-        bool active = true;
+
+        //Names are fixed by the problem, not compared
+        bool operator==(const ELEMENT& e) const{
+            return id == e.id && capacity == e.capacity && cost == e.cost && priority == e.priority &&
+                measured == e.measured && count == e.count &&
+                needed == e.needed && low == e.low && empty == e.empty &&
+                LikelihoodEmpty == e.LikelihoodEmpty && LikelihoodNotEmpty == e.LikelihoodNotEmpty &&
+                ProbEmpty == e.ProbEmpty;
+        }
     };
     vector<ELEMENT> containers;
     vector<int> storage; //True amount of objs. in containers
@@ -123,7 +134,6 @@ public:
         containers.clear();
         storage.clear();
     }
-    void activateFeature(int feature, bool status);
 };
 
 class ASSEMBLY_ROBOT : public SIMULATOR{
@@ -155,6 +165,7 @@ public:
     //Compute PGS value
     double PGS(STATE& state) const;
     double PGS_RO(STATE& oldstate, STATE& state, int action, double oldpgs) const;  //PGS for rollouts
+    virtual bool PGSDeltas(const STATE& state, const std::vector<int>& actions, double* deltas) const;
 
     ///// Incremental refinement /////
     //std::vector<FTABLE::F_ENTRY>& getInitialFTable() const {}
@@ -171,6 +182,11 @@ public:
                            std::vector<int>& legal, const STATUS& status) const;
     virtual bool LocalMove(STATE& state, const HISTORY& history,
                            int stepObservation, const STATUS& status) const;
+    virtual std::size_t Hash(const STATE& state) const;
+    virtual bool Equal(const STATE& state1, const STATE& state2) const;
+    virtual std::size_t Discretise(const STATE& state) const;
+    virtual bool Pack(const STATE& state, UTILS::BIT_WRITER& bits, std::vector<double>& probs) const;
+    virtual void Unpack(UTILS::BIT_READER& bits, const double* probs, STATE& state) const;
 
     virtual void DisplayBeliefs(const BELIEF_STATE& beliefState,
                                 std::ostream& ostr) const;
@@ -190,6 +206,15 @@ protected:
     void Init_Demo1();
     
     bool BinEntropyCheck(double p) const; //Verify that p satisfies threshold
+
+    //Terms PGS_RO takes from the state before a step, so StepPGS needs no copy of it
+    struct PGS_BEFORE{
+        double points; //Old points that only depend on the old state
+        int truck; //Current truck
+        bool truckUncertain; //and whether its type was uncertain
+    };
+    void PGSBefore(const ASSEMBLY_ROBOT_STATE& oldRState, int action, PGS_BEFORE& before) const;
+    double PGSAfter(const ASSEMBLY_ROBOT_STATE& rState, int action, const PGS_BEFORE& before, double oldpgs) const;
     
     /* Domain functions */
     double Perceive(const ASSEMBLY_ROBOT_STATE& state, OBSERVATION_TRIPLE& obs) const; //Simulate worker observation tuple and store in "obs".  Return accuracy.        
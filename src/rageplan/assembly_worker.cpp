@@ -113,7 +113,7 @@ ASSEMBLY_STATE* ASSEMBLY_WORKER::createStartState() const{
 }
 
 double ASSEMBLY_WORKER::Bernoulli(double p) const{    
-    return rand() < p * RAND_MAX;
+    return UTILS::Rand() < p * RAND_MAX;
 }
 
 //Step and outcome functions w/o state
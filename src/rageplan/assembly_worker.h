@@ -69,6 +69,7 @@ struct ASSEMBLY_PARAMS{
 		part_priority = {1,1,1,1,1,1,1};
 		part_cost = {0,0,0,0,0,0,0};
 		storage = {2,2,1,1,1,1,1};
+		needsGlue = {true, true};
 
 		//Truck parts mapping:
 		vector<int> yellow = {0,1,2,5,6};
@@ -88,6 +89,11 @@ struct PART{
 	int number;
 	int priority;
 	bool assembled = false;
+
+	//Names are fixed by the problem, not compared
+	bool operator==(const PART& p) const{
+		return number == p.number && priority == p.priority && assembled == p.assembled;
+	}
 };
 
 struct TRUCK{
@@ -97,6 +103,11 @@ struct TRUCK{
 	bool complete = false;
 	vector<PART> parts;
 	double percentageComplete = 0;
+
+	bool operator==(const TRUCK& t) const{
+		return type == t.type && needsGlue == t.needsGlue && complete == t.complete &&
+			percentageComplete == t.percentageComplete && parts == t.parts;
+	}
 };
 
 class ASSEMBLY_STATE{
@@ -129,6 +140,11 @@ class ASSEMBLY_STATE{
 			
 			trucks = s.trucks;
 		}
+
+		bool operator==(const ASSEMBLY_STATE& s) const{
+			return activity == s.activity && pose == s.pose && outcome == s.outcome &&
+				truck == s.truck && glueType == s.glueType && trucks == s.trucks;
+		}
 };
 
 class ASSEMBLY_WORKER{
@@ -1,10 +1,15 @@
 #include "beliefstate.h"
 #include "simulator.h"
 #include "utils.h"
+#include <algorithm>
+#include <unordered_map>
 
 using namespace UTILS;
 
 BELIEF_STATE::BELIEF_STATE()
+:   NumPacked(0),
+    WordStride(0),
+    ProbStride(0)
 {
     Samples.clear();
 }
@@ -16,54 +21,329 @@ void BELIEF_STATE::Free(const SIMULATOR& simulator)
     {
         //cout << "Freeing belief state: "<<endl;
         //simulator.DisplayState(**i_state, cout);
-        simulator.FreeState(*i_state);
+        Release(*i_state, simulator);
     }
     Samples.clear();
+    Cumulative.clear();
+    NumPacked = 0;
+    std::vector<uint64_t>().swap(PackedWords); //Release the memory, nodes are pooled
+    std::vector<double>().swap(PackedProbs);
+    std::vector<int>().swap(ProbBlocks);
+}
+
+void BELIEF_STATE::Release(STATE* state, const SIMULATOR& simulator)
+{
+    if (__atomic_sub_fetch(&state->RefCount, 1, __ATOMIC_ACQ_REL) == 0)
+        simulator.FreeState(state);
 }
 
 STATE* BELIEF_STATE::CreateSample(const SIMULATOR& simulator) const
 {
-    
-    int index = Random(Samples.size());
-    
-    return simulator.Copy(*Samples[index]);
+    return CreateSample(SampleIndex(), simulator);
+}
+
+// Packed samples are decoded into a copy of the first one
+STATE* BELIEF_STATE::CreateSample(int index, const SIMULATOR& simulator) const
+{
+    if (!NumPacked)
+        return simulator.Copy(*Samples[index]);
+
+    STATE* state = simulator.Copy(*Samples[0]);
+    if (index > 0)
+    {
+        BIT_READER bits(&PackedWords[(std::size_t) index * WordStride]);
+        simulator.Unpack(bits, &PackedProbs[(std::size_t) ProbBlocks[index] * ProbStride], *state);
+    }
+    return state;
 }
 
-void BELIEF_STATE::AddSample(STATE* state)
+int BELIEF_STATE::SampleIndex() const
+{
+    if (Cumulative.empty())
+        return Random(GetNumSamples());
+
+    double u = RandomDouble(0, Cumulative.back());
+    int index = std::upper_bound(Cumulative.begin(), Cumulative.end(), u) - Cumulative.begin();
+    return std::min(index, GetNumSamples() - 1);
+}
+
+void BELIEF_STATE::ShareSample(const BELIEF_STATE& beliefs, int index)
+{
+    assert(!NumPacked && !beliefs.NumPacked);
+    STATE* state = beliefs.Samples[index];
+    if (!Cumulative.empty())
+        Cumulative.push_back(GetTotalWeight() + 1.0);
+    AtomicAdd(state->RefCount, 1);
+    Samples.push_back(state);
+}
+
+void BELIEF_STATE::AddSample(STATE* state, double weight)
 {       
+    assert(!NumPacked);
+    if (weight != 1.0 && Cumulative.empty())
+        SetWeighted();
+    if (!Cumulative.empty())
+        Cumulative.push_back(GetTotalWeight() + weight);
+    state->RefCount = 1;
     Samples.push_back(state);    
 }
 
+double BELIEF_STATE::GetWeight(int index) const
+{
+    if (Cumulative.empty())
+        return 1.0;
+    return index == 0 ? Cumulative[0] : Cumulative[index] - Cumulative[index - 1];
+}
+
+// (sum w)^2 / sum w^2, the no. of unweighted samples worth as much as this belief
+double BELIEF_STATE::GetEffectiveSampleSize() const
+{
+    if (Cumulative.empty())
+        return GetNumSamples();
+
+    double sumSq = 0;
+    for (int i = 0; i < GetNumSamples(); i++)
+        sumSq += GetWeight(i) * GetWeight(i);
+    return sumSq > 0 ? GetTotalWeight() * GetTotalWeight() / sumSq : 0;
+}
+
+// Give the current samples explicit unit weights
+void BELIEF_STATE::SetWeighted()
+{
+    Cumulative.resize(GetNumSamples());
+    for (int i = 0; i < GetNumSamples(); i++)
+        Cumulative[i] = i + 1;
+}
+
+// Weights for the samples of beliefs, before they are appended
+void BELIEF_STATE::AppendWeights(const BELIEF_STATE& beliefs)
+{
+    if (beliefs.Empty() || (Cumulative.empty() && beliefs.Cumulative.empty()))
+        return;
+    if (Cumulative.empty())
+        SetWeighted();
+
+    double total = GetTotalWeight();
+    for (int i = 0; i < beliefs.GetNumSamples(); i++)
+        Cumulative.push_back(total += beliefs.GetWeight(i));
+}
+
 /*
 	TODO: Moving feature activation here would perform one less loop
 */
 void BELIEF_STATE::Copy(const BELIEF_STATE& beliefs, const SIMULATOR& simulator)
 {
+    if (beliefs.Empty()) //Nothing to add, this belief state may be packed
+        return;
+    assert(!NumPacked && (!beliefs.NumPacked || Samples.empty()));
+    AppendWeights(beliefs);
+    if (beliefs.NumPacked)
+    {
+        NumPacked = beliefs.NumPacked;
+        WordStride = beliefs.WordStride;
+        ProbStride = beliefs.ProbStride;
+        PackedWords = beliefs.PackedWords;
+        PackedProbs = beliefs.PackedProbs;
+        ProbBlocks = beliefs.ProbBlocks;
+    }
     for (std::vector<STATE*>::const_iterator i_state = beliefs.Samples.begin();
         i_state != beliefs.Samples.end(); ++i_state)
     {
-        //TODO: Copy state once features have been revised
-		  //(**i_state).validateTable();
         //cout << "Adding sample" <<endl;
         //simulator.DisplayState(**i_state, cout);
-        AddSample(simulator.Copy(**i_state));        
+        AtomicAdd((*i_state)->RefCount, 1);
+        Samples.push_back(*i_state);
     }
 }
 
 void BELIEF_STATE::Move(BELIEF_STATE& beliefs)
 {
-    for (std::vector<STATE*>::const_iterator i_state = beliefs.Samples.begin();
-        i_state != beliefs.Samples.end(); ++i_state)
+    if (beliefs.Empty()) //Nothing to add, this belief state may be packed
+        return;
+    assert(!NumPacked && (!beliefs.NumPacked || Samples.empty()));
+    AppendWeights(beliefs);
+    if (beliefs.NumPacked)
     {
-        AddSample(*i_state);
+        std::swap(NumPacked, beliefs.NumPacked);
+        WordStride = beliefs.WordStride;
+        ProbStride = beliefs.ProbStride;
+        PackedWords.swap(beliefs.PackedWords);
+        PackedProbs.swap(beliefs.PackedProbs);
+        ProbBlocks.swap(beliefs.ProbBlocks);
     }
+    if (Samples.empty())
+        Samples.swap(beliefs.Samples);
+    else
+        Samples.insert(Samples.end(), beliefs.Samples.begin(), beliefs.Samples.end());
     beliefs.Samples.clear();
+    beliefs.Cumulative.clear();
 }
 
-void BELIEF_STATE::activateFeature(int feature, bool status){
-    for (std::vector<STATE*>::const_iterator i_state = Samples.begin();
-        i_state != Samples.end(); ++i_state){
+/*
+  Systematic resampling: numSamples evenly spaced points, with one random
+  offset, pick samples through the cumulative weights. Samples picked more
+  than once are shared.
+*/
+void BELIEF_STATE::Resample(int numSamples, const SIMULATOR& simulator)
+{
+    assert(!NumPacked);
+    if (Samples.empty())
+        return;
 
-        (*i_state)->activateFeature(feature, status);
+    std::vector<STATE*> samples;
+    samples.reserve(numSamples);
+    double step = GetTotalWeight() / numSamples;
+    double u = RandomDouble(0, step);
+    int index = 0;
+    for (int n = 0; n < numSamples; n++, u += step)
+    {
+        while (index < Samples.size() - 1 &&
+            (Cumulative.empty() ? index + 1 : Cumulative[index]) <= u)
+            index++;
+        AtomicAdd(Samples[index]->RefCount, 1);
+        samples.push_back(Samples[index]);
+    }
+
+    Free(simulator);
+    Samples.swap(samples);
+}
+
+/*
+  Duplicates are found through SIMULATOR::Hash and Equal, or by identity for
+  simulators without a hash (e.g. particles shared after Resample). The
+  merged particle's weight is the sum of the duplicates' weights, so
+  CreateSample draws from the same distribution as before.
+*/
+int BELIEF_STATE::Compact(const SIMULATOR& simulator)
+{
+    assert(!NumPacked);
+    std::unordered_map<std::size_t, std::vector<int> > buckets; //Hash -> indices into samples
+    std::vector<STATE*> samples;
+    std::vector<double> weights;
+
+    for (int i = 0; i < Samples.size(); i++)
+    {
+        STATE* state = Samples[i];
+        std::size_t hash = simulator.Hash(*state);
+        if (hash == 0)
+            hash = std::hash<STATE*>()(state);
+
+        std::vector<int>& bucket = buckets[hash];
+        int match = -1;
+        for (int j = 0; j < bucket.size() && match < 0; j++)
+        {
+            STATE* other = samples[bucket[j]];
+            if (other == state || simulator.Equal(*other, *state))
+                match = bucket[j];
+        }
+
+        if (match >= 0)
+        {
+            weights[match] += GetWeight(i);
+            Release(state, simulator);
+        }
+        else
+        {
+            bucket.push_back(samples.size());
+            samples.push_back(state);
+            weights.push_back(GetWeight(i));
+        }
+    }
+
+    int removed = Samples.size() - samples.size();
+    if (removed > 0)
+    {
+        Samples.swap(samples);
+        Cumulative.resize(weights.size());
+        double total = 0;
+        for (int i = 0; i < weights.size(); i++)
+            Cumulative[i] = total += weights[i];
+    }
+    return removed;
+}
+
+/*
+  Particles are packed one after the other with a fixed stride. Their
+  probabilities mostly agree (they follow the same observations), so each
+  distinct block of probabilities is stored once and indexed.
+*/
+void BELIEF_STATE::Pack(const SIMULATOR& simulator)
+{
+    if (NumPacked || Samples.size() < 2)
+        return;
+
+    std::vector<uint64_t> words;
+    std::vector<double> probs, blockProbs;
+    std::vector<int> blocks;
+    std::unordered_multimap<std::size_t, int> blockIndex;
+    int wordStride = 0, probStride = 0;
+
+    for (int i = 0; i < Samples.size(); i++)
+    {
+        int numWords = words.size();
+        BIT_WRITER bits(words);
+        probs.clear();
+        if (!simulator.Pack(*Samples[i], bits, probs))
+            return;
+
+        if (i == 0)
+        {
+            wordStride = words.size();
+            probStride = probs.size();
+            words.reserve((std::size_t) wordStride * Samples.size());
+        }
+        assert(words.size() - numWords == wordStride && probs.size() == probStride);
+
+        std::size_t hash = 1;
+        for (int p = 0; p < probStride; p++)
+            HashCombine(hash, probs[p]);
+        int block = -1;
+        auto range = blockIndex.equal_range(hash);
+        for (auto b = range.first; b != range.second && block < 0; ++b)
+            if (std::equal(probs.begin(), probs.end(), blockProbs.begin() + (std::size_t) b->second * probStride))
+                block = b->second;
+        if (block < 0)
+        {
+            block = blockIndex.size();
+            blockIndex.insert(std::make_pair(hash, block));
+            blockProbs.insert(blockProbs.end(), probs.begin(), probs.end());
+        }
+        blocks.push_back(block);
+    }
+
+    NumPacked = Samples.size();
+    WordStride = wordStride;
+    ProbStride = probStride;
+    PackedWords.swap(words);
+    PackedProbs.swap(blockProbs);
+    ProbBlocks.swap(blocks);
+    for (int i = 1; i < Samples.size(); i++)
+        Release(Samples[i], simulator);
+    Samples.resize(1);
+}
+
+void BELIEF_STATE::Unpack(const SIMULATOR& simulator)
+{
+    if (!NumPacked)
+        return;
+
+    std::vector<STATE*> samples(1, Samples[0]);
+    samples.reserve(NumPacked);
+    for (int i = 1; i < NumPacked; i++)
+    {
+        STATE* state = CreateSample(i, simulator);
+        state->RefCount = 1;
+        samples.push_back(state);
     }
+    Samples.swap(samples);
+    NumPacked = 0;
+    std::vector<uint64_t>().swap(PackedWords);
+    std::vector<double>().swap(PackedProbs);
+    std::vector<int>().swap(ProbBlocks);
+}
+
+std::size_t BELIEF_STATE::GetPackedBytes() const
+{
+    return PackedWords.size() * sizeof(uint64_t) + PackedProbs.size() * sizeof(double) +
+        ProbBlocks.size() * sizeof(int);
 }
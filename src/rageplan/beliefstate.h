@@ -2,42 +2,83 @@
 #define BELIEF_STATE_H
 
 #include <vector>
+#include <stdint.h>
+#include <assert.h>
 
 class STATE;
 class SIMULATOR;
 
+// Particles are immutable and reference counted, so several belief states
+// can share them. Simulations only ever work on private copies (CreateSample).
+// Particles may carry weights, beliefs stay unweighted until a sample is
+// added with a weight other than 1.
+// Packed beliefs hold their particles encoded (see Pack) and only support
+// sampling and Copy/Move into an empty belief state, until unpacked.
+
 class BELIEF_STATE
 {
 public:
 
     BELIEF_STATE();
 
-    // Free memory for all states
+    // Release all states, freeing those no other belief state holds
     void Free(const SIMULATOR& simulator);
 
     // Creates new state, now owned by caller
     STATE* CreateSample(const SIMULATOR& simulator) const;
+    STATE* CreateSample(int index, const SIMULATOR& simulator) const;
+
+    // Random sample index, drawn by weight
+    int SampleIndex() const;
+
+    // Add sample index of beliefs to this belief state, shared with unit weight
+    void ShareSample(const BELIEF_STATE& beliefs, int index);
 
     // Added state is owned by belief state
-    void AddSample(STATE* state);
+    void AddSample(STATE* state, double weight = 1.0);
 
-    // Make own copies of all samples
+    // Share all samples of beliefs (no states are copied)
     void Copy(const BELIEF_STATE& beliefs, const SIMULATOR& simulator);
 
     // Move all samples into this belief state
     void Move(BELIEF_STATE& beliefs);
 
+    // Systematic resampling to numSamples unweighted samples
+    void Resample(int numSamples, const SIMULATOR& simulator);
+
+    // Merge equal samples into one, weighted by multiplicity. Returns no. removed
+    int Compact(const SIMULATOR& simulator);
+
+    // Encode all samples into packed words (SIMULATOR::Pack), equal
+    // probability blocks are stored once. The first sample stays decoded
+    void Pack(const SIMULATOR& simulator);
+    void Unpack(const SIMULATOR& simulator);
+    bool IsPacked() const { return NumPacked > 0; }
+    std::size_t GetPackedBytes() const;
+
     bool Empty() const { return Samples.empty(); }
-    int GetNumSamples() const { return Samples.size(); }
-    const STATE* GetSample(int index) const { return Samples[index]; }
+    int GetNumSamples() const { return NumPacked ? NumPacked : Samples.size(); }
+    const STATE* GetSample(int index) const { assert(!NumPacked || index == 0); return Samples[index]; }
     const STATE* GetMostRecentSample() const { return Samples.back(); }
-
-    //Feature activation in all states
-    void activateFeature(int feature, bool status);
+    bool IsWeighted() const { return !Cumulative.empty(); }
+    double GetWeight(int index) const;
+    double GetTotalWeight() const { return Cumulative.empty() ? GetNumSamples() : Cumulative.back(); }
+    double GetEffectiveSampleSize() const;
 
 private:
 
+    void SetWeighted();
+    void AppendWeights(const BELIEF_STATE& beliefs);
+    void Release(STATE* state, const SIMULATOR& simulator);
+
     std::vector<STATE*> Samples;
+    std::vector<double> Cumulative; //Running total of the weights, empty while all weights are 1
+
+    int NumPacked; //No. of packed samples (0 = unpacked)
+    int WordStride, ProbStride; //Packed size of one sample
+    std::vector<uint64_t> PackedWords;
+    std::vector<double> PackedProbs; //Distinct probability blocks
+    std::vector<int> ProbBlocks; //Block of each packed sample
 };
 
 #endif // BELIEF_STATE_H
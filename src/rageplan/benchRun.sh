@@ -0,0 +1,28 @@
+#!/bin/sh
+
+### Parallel search benchmark: serial vs. root- vs. tree-parallel MCTS
+### on the first decision of hotel and rocksample
+
+threads=4
+minDoubles=12
+maxDoubles=16
+runs=20
+rolloutKnowledge=3
+planningTime=0 #Search deadline in seconds, 0 = run all simulations
+
+./rageH2 --problem hotel --inputFile hotel.prob --minDoubles $minDoubles --maxDoubles $maxDoubles --runs $runs --rolloutKnowledge $rolloutKnowledge --threads $threads --planningTime $planningTime --benchmark 1 --outputFile hotel.bench.out
+
+./rageH2 --problem rocksample --size 7 --number 8 --minDoubles $minDoubles --maxDoubles $maxDoubles --runs $runs --rolloutKnowledge $rolloutKnowledge --threads $threads --planningTime $planningTime --benchmark 1 --outputFile rocksample.bench.out
+
+### PGS benchmark: GeneratePGS with simulated vs. analytic action scores
+### (--analyticPGS 0/1), per call and in search throughput
+
+pgsDoubles=12
+pgsRuns=20
+numSteps=100
+
+./rageH2 --problem hotel --inputFile hotel.prob --minDoubles $pgsDoubles --maxDoubles $pgsDoubles --runs $pgsRuns --numSteps $numSteps --rolloutKnowledge $rolloutKnowledge --benchmark 2 --outputFile hotel.pgs.out
+
+./rageH2 --problem assembly --inputFile assembly.prob --minDoubles $pgsDoubles --maxDoubles $pgsDoubles --runs $pgsRuns --numSteps $numSteps --rolloutKnowledge $rolloutKnowledge --benchmark 2 --outputFile assembly.pgs.out
+
+./rageH2 --problem mobipick --inputFile mobipick.prob --minDoubles $pgsDoubles --maxDoubles $pgsDoubles --runs $pgsRuns --numSteps $numSteps --rolloutKnowledge $rolloutKnowledge --benchmark 2 --outputFile mobipick.pgs.out
@@ -6,11 +6,6 @@
 using namespace std;
 using namespace UTILS;
 
-void CELLAR_STATE::activateFeature(int feature, bool status){
-	if(feature >= 0 && feature < Objects.size())
-		Objects[feature].active = status;
-}
-
 /* Build Ftable mapping features to their afforded actions
  */
 void CELLAR::initializeFTable(FTABLE& ftable) const{
@@ -457,7 +452,6 @@ STATE* CELLAR::CreateStartState() const
         entry.LikelihoodCrate = 1.0;
         entry.LikelihoodShelf = 1.0;
 		entry.AssumedType = E_NONE;
-		entry.active = true;
         cellarstate->Objects.push_back(entry);
     }
 	
@@ -497,17 +491,21 @@ bool CELLAR::StepPGS(STATE& state, int action,
 {
 	double r = 0.0;
 	double r2 = 0.0;
-	STATE* oldstate = Copy(state);	
+	CELLAR_STATE& cellarstate = safe_cast<CELLAR_STATE&>(state);
+	
+	//Old potential and the old points of PGS_RO, read before the step instead of copying the state
+	r2 = PGS(state);
+	double oldpoints = 0.0;
+	if(action >= E_BOTTLECHECK && action < E_OBJCHECK)
+		oldpoints = ActionPoints(cellarstate, action);
 	
 	bool result = StepNormal(state, action, observation, reward);
 
 	if(reward != -100){//Not terminal or out of bounds
-		r2 = PGS(*oldstate);
-		r = PGS_RO(*oldstate, state, action, r2);
+		r = r2 - oldpoints + ActionPoints(cellarstate, action); //As PGS_RO
 	
 		reward += PGSAlpha*r - PGSAlpha*r2;
 	}
-	FreeState(oldstate);
 	
 	return result;
 }
@@ -823,15 +821,10 @@ bool CELLAR::LocalMove(STATE& state, const HISTORY& history,
 /* PGS Rollout policy
  * Simplified PGS point count
  */
-double CELLAR::PGS_RO(STATE& oldstate, STATE& state, int action, double oldpgs) const
+/* PGS points of the bottle sampled or checked by action (0 for other actions) */
+double CELLAR::ActionPoints(const CELLAR_STATE& cellarstate, int action) const
 {
 	double points = 0.0;
-	double oldpoints = 0.0;
-	
-	//1. Cast to cellarstate
-	CELLAR_STATE& cellarstate = safe_cast<CELLAR_STATE&>(state);
-	CELLAR_STATE& oldcellarstate = safe_cast<CELLAR_STATE&>(oldstate);
-	
 	int bottle = -1;
 	if(action >= E_SAMPLE && action < E_BOTTLECHECK){
 		bottle = Grid(cellarstate.AgentPos);
@@ -847,12 +840,23 @@ double CELLAR::PGS_RO(STATE& oldstate, STATE& state, int action, double oldpgs)
 		double p = cellarstate.Bottles[bottle].ProbValuable;
 		double binaryEntropy = -1*p*log2(p) - (1-p)*log2(1-p);
 		if(binaryEntropy > CELLAR::BIN_ENTROPY_LIMIT) points--;
-		
-		p = oldcellarstate.Bottles[bottle].ProbValuable;
-		double oldBinaryEntropy = -1*p*log2(p) - (1-p)*log2(1-p);
-		if(oldBinaryEntropy > CELLAR::BIN_ENTROPY_LIMIT) oldpoints--;
 		//else points -= 0.5;
 	}
+	return points;
+}
+
+double CELLAR::PGS_RO(STATE& oldstate, STATE& state, int action, double oldpgs) const
+{
+	double points = 0.0;
+	double oldpoints = 0.0;
+	
+	//1. Cast to cellarstate
+	CELLAR_STATE& cellarstate = safe_cast<CELLAR_STATE&>(state);
+	CELLAR_STATE& oldcellarstate = safe_cast<CELLAR_STATE&>(oldstate);
+	
+	points = ActionPoints(cellarstate, action);
+	if (action >= E_BOTTLECHECK && action < E_OBJCHECK) //Bottle check
+		oldpoints = ActionPoints(oldcellarstate, action);
 
 	//Update difference for current bottle
 	double result = oldpgs - oldpoints + points;
@@ -897,7 +901,7 @@ double CELLAR::PGS(STATE& state) const
 void CELLAR::GeneratePGS(const STATE& state, const HISTORY& history,
     vector<int>& legal, const STATUS& status) const
 {
-	static vector<int> acts;
+	static thread_local vector<int> acts;
 	acts.clear();
 	STATE * newstate;
 	STATE * oldstate = Copy(state);
@@ -989,7 +993,7 @@ void CELLAR::PGSLegal(const STATE& state, const HISTORY& history,
 	*/
 	// 'Check' possible for ACTIVE objects without an assumed type		  
 	for (int obj = 0; obj < NumObjects; ++obj){
-		if(cellarstate.Objects[obj].AssumedType == E_NONE && cellarstate.Objects[obj].active)
+		if(cellarstate.Objects[obj].AssumedType == E_NONE && IsActive(obj))
 			legal.push_back(E_OBJCHECK + obj);
 	}
 		  
@@ -1020,7 +1024,7 @@ void CELLAR::PGSLegal(const STATE& state, const HISTORY& history,
 
 	//Pushing is allowed for active objects only
 	for(int i=0; i<cellarstate.Objects.size() && !objsFound; i++){
-		if(cellarstate.Objects[i].active){ //only use active objects
+		if(IsActive(i)){ //only use active objects
 			if(cellarstate.Objects[i].ObjPos == posN){
 				objN = true;
 				numObjN = i;
@@ -1124,7 +1128,7 @@ void CELLAR::GenerateLegal(const STATE& state, const HISTORY& history,
 	bool objsFound = false; //objN && objE && objS && objW;
 		  
 	for(int i=0; i<cellarstate.Objects.size() && !objsFound; i++){
-	 	if(cellarstate.Objects[i].active){
+	 	if(IsActive(i)){
 			if (cellarstate.Objects[i].ObjPos == posN) {
 				objN = true;
 				numObjN = i;
@@ -1322,7 +1326,7 @@ void CELLAR::GeneratePreferred(const STATE& state, const HISTORY& history,
 	bool objsFound = objN && objE && objS && objW;
 		  
 	for(int i=0; i<cellarstate.Objects.size() && !objsFound; i++){
-        if(cellarstate.Objects[i].active) {
+        if(IsActive(i)) {
             if (cellarstate.Objects[i].ObjPos == posN) {
                 objN = true;
                 numObjN = i;
@@ -1482,7 +1486,7 @@ void CELLAR::DisplayState(const STATE& state, std::ostream& ostr) const
 						int obj = ObjectNumber(cellarstate, pos);						
 						if(obj >= 0){
 							const CELLAR_STATE::OBJ_ENTRY& entry = cellarstate.Objects[obj];
-							if(entry.active)
+							if(IsActive(obj))
 								ostr << obj << (entry.Type == E_SHELF ? "S" : "C");
 							else
 								ostr << obj << "!";
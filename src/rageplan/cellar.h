@@ -80,13 +80,10 @@ public:
         double LikelihoodShelf;	// Smart knowledge
         double ProbCrate;		// Smart knowledge
 		  int AssumedType;		// Assumptions
-		  bool active;				//activate/deactivate based on value
     };
 	 std::vector<OBJ_ENTRY> Objects;
     int Target; // Smart knowledge
 	 int CollectedBottles;
-	 
-	 void activateFeature(int feature, bool status);
 };
 
 class CELLAR : public SIMULATOR
@@ -119,6 +116,7 @@ public:
 	//Compute PGS value
 	double PGS(STATE& state) const;
 	double PGS_RO(STATE& oldstate, STATE& state, int action, double oldpgs) const;  //PGS for rollouts
+	double ActionPoints(const CELLAR_STATE& cellarstate, int action) const; //PGS points of the bottle affected by action
 	
 	///// Incremental refinement /////	
 	std::vector<FTABLE::F_ENTRY>& getInitialFTable() const {}
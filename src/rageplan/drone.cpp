@@ -7,12 +7,6 @@
 using namespace std;
 using namespace UTILS;
 
-void DRONE_STATE::activateFeature(int feature, bool status){
-    if(feature >= 0){
-        Features[feature].active = status;
-    }
-}
-
 /* Build Ftable mapping every action to its affected feature/object */
 void DRONE::initializeFTable(FTABLE& ftable) const{
 
@@ -328,7 +322,6 @@ STATE* DRONE::CreateStartState() const
         entry.numPhotos = 0;
         entry.measured = 0;
         entry.count = 0;
-        entry.active = true;
 
         droneState->Features.push_back(entry);
     }
@@ -375,7 +368,6 @@ STATE* DRONE::CreateStartState() const
         entry.numPhotos = 0;
         entry.measured = 0;
         entry.count = 0;
-        entry.active = true;
 
         droneState->Features.push_back(entry);
     }
@@ -417,21 +409,28 @@ bool DRONE::StepPGS(STATE& state, int action,
     double scale = 10.0;
     double r = 0.0;
     double r2 = 0.0;
-    STATE* oldstate = Copy(state);
+    DRONE_STATE& droneState = safe_cast<DRONE_STATE&>(state);
+
+    //Old potential and the old values PGS_RO reads, taken before the step instead of copying the state
+    r2 = PGS(state);
+    double oldpoints = 0.0;
+    bool firstPhoto = false;
+    if(action >= E_PHOTO)
+        firstPhoto = !droneState.Features[action - E_PHOTO].numPhotos;
+    else if(action >= E_IDENTIFY)
+        oldpoints = ActionPoints(droneState, action, false);
 
     bool terminal = StepNormal(state, action, observation, reward);
 
     // Potential-based reward bonus
     if(!terminal){//Not terminal or out of bounds
-        r2 = PGS(*oldstate);
-        r = PGS_RO(*oldstate, state, action, r2); //PGS(state);
+        r = r2 - oldpoints + ActionPoints(droneState, action, firstPhoto); //As PGS_RO
         reward += scale*r - scale*r2;
         /*if(action >= E_IDENTIFY && action < E_PHOTO){
             DisplayAction(action, cout);
             cout << "PGS bonus: " << scale*r - scale*r2 << endl;
         }*/
     }
-    FreeState(oldstate);
 
     return terminal;
 }
@@ -792,24 +791,19 @@ bool DRONE::LocalMove(STATE& state, const HISTORY& history,
 /* Fast PGS for Rollout policy
  * Simplified PGS point count by using only the specific action changes
  */
-double DRONE::PGS_RO(STATE& oldstate, STATE& state, int action, double oldpgs) const
+/* PGS points of the creature photographed or identified by action (0 for other
+ * actions). A photo only scores if it is the first one, as told by firstPhoto
+ */
+double DRONE::ActionPoints(const DRONE_STATE& droneState, int action, bool firstPhoto) const
 {
     double points = 0.0;
-    double oldpoints = 0.0;
-
-    //1. Cast to cellarstate
-    DRONE_STATE& droneState = safe_cast<DRONE_STATE&>(state);
-    DRONE_STATE& oldDroneState = safe_cast<DRONE_STATE&>(oldstate);
-
     int creature;
-    int cell;
     //1. Photos
     if(action >= E_PHOTO){
         creature = action - E_PHOTO;
         if (droneState.Features[creature].Position == droneState.AgentPos){
             if(droneState.Features[creature].Target){
-                if(droneState.Features[creature].AssumedTarget &&
-                    !oldDroneState.Features[creature].numPhotos)
+                if(droneState.Features[creature].AssumedTarget && firstPhoto)
                 points++; //Add one point for the first (correct) picture
             }
             else points--;
@@ -820,9 +814,30 @@ double DRONE::PGS_RO(STATE& oldstate, STATE& state, int action, double oldpgs) c
         creature = action - E_IDENTIFY;
         double p = droneState.Features[creature].ProbTarget;
         if(!BinEntropyCheck(p)) points--;
+    }
+    return points;
+}
+
+double DRONE::PGS_RO(STATE& oldstate, STATE& state, int action, double oldpgs) const
+{
+    double points = 0.0;
+    double oldpoints = 0.0;
+
+    //1. Cast to cellarstate
+    DRONE_STATE& droneState = safe_cast<DRONE_STATE&>(state);
+    DRONE_STATE& oldDroneState = safe_cast<DRONE_STATE&>(oldstate);
 
-        p = oldDroneState.Features[creature].ProbTarget;
-        if(!BinEntropyCheck(p)) oldpoints--;
+    int creature;
+    int cell;
+    //1. Photos
+    if(action >= E_PHOTO){
+        creature = action - E_PHOTO;
+        points = ActionPoints(droneState, action, !oldDroneState.Features[creature].numPhotos);
+    }
+    //2. Identify
+    else if (action >= E_IDENTIFY){
+        points = ActionPoints(droneState, action, false);
+        oldpoints = ActionPoints(oldDroneState, action, false);
     }
     //3. Location of creatures
     /*else if (action >= E_CHECK){
@@ -898,7 +913,7 @@ double DRONE::PGS(STATE& state) const
 void DRONE::GeneratePGS(const STATE& state, const HISTORY& history,
                          vector<int>& legal, const STATUS& status) const
 {
-    static vector<int> acts;
+    static thread_local vector<int> acts;
     acts.clear();
     STATE * newstate;
     PGSLegal(state, history, acts, status);
@@ -986,7 +1001,7 @@ void DRONE::PGSLegal(const STATE& state, const HISTORY& history,
 //        cout << "RO: Identify f " << people[f] << " in room " << Grid.Index(droneState.AgentPos) << endl;
         if(droneState.Features[f].ObservedPosition == droneState.AgentPos &&
             //droneState.Features[f].ProbPosition >= 0.5 &&
-            droneState.Features[f].active) {
+            IsActive(f)) {
                 legal.push_back(E_PHOTO + f);
 //                if(!droneState.Features[f].AssumedTarget)
                     legal.push_back(E_IDENTIFY + f);
@@ -61,12 +61,8 @@ public:
         int numPhotos;
         int measured;
         int count;
-        //Relevance
-        bool active;
     };
     std::vector<P_ENTRY> Features;
-
-    void activateFeature(int feature, bool status);
 };
 
 class DRONE : public SIMULATOR
@@ -99,6 +95,7 @@ public:
     //Compute PGS value
     double PGS(STATE& state) const;
     double PGS_RO(STATE& oldstate, STATE& state, int action, double oldpgs) const;  //PGS for rollouts
+    double ActionPoints(const DRONE_STATE& droneState, int action, bool firstPhoto) const; //PGS points of the creature affected by action
 
     ///// Incremental refinement /////
     std::vector<FTABLE::F_ENTRY>& getInitialFTable() const {}
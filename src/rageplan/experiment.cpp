@@ -33,7 +33,6 @@ EXPERIMENT::EXPERIMENT(const SIMULATOR& real,
     if (ExpParams.AutoExploration){
         SearchParams.ExplorationConstant = simulator.GetRewardRange();
     }
-    MCTS::InitFastUCB(SearchParams.ExplorationConstant);
 }
 
 // TODO: This is the target function to adapt for a ROS-POMCP
@@ -67,6 +66,8 @@ void EXPERIMENT::Run()
 
         //cout << "MCTS select action" << endl;
         int action = mcts->SelectAction(); ///MCTS search
+        if (SearchParams.EarlyStopDelta > 0)
+            Results.SimulationsSaved.Add(mcts->GetSimulationsSaved());
         
         //cout << "Real step" << endl;
         terminal = Real.Step(*state, action, observation, reward); //TODO: Transfer control to ROS/external actions, MBF, etc. Receive observation and reward.
@@ -224,6 +225,9 @@ void EXPERIMENT::DiscountedReturn()
             << "Discounted return = " << Results.DiscountedReturn.GetMean()
             << " +- " << Results.DiscountedReturn.GetStdErr() << endl
             << "Time = " << Results.Time.GetMean() << endl;
+        if (SearchParams.EarlyStopDelta > 0)
+            cout << "Simulations saved per step = " << Results.SimulationsSaved.GetMean()
+                << " +- " << Results.SimulationsSaved.GetStdErr() << endl;
 		  
         OutputFile << SearchParams.NumSimulations << "\t"
             << Results.Time.GetCount() << "\t"
@@ -270,4 +274,151 @@ void EXPERIMENT::AverageReward()
     }
 }
 
+/*
+  Compare serial, root-parallel and tree-parallel search on the first
+  decision of an episode. For each mode the throughput (simulations/s) and
+  the root value of the chosen action are averaged over NumRuns searches.
+  The search deadline (MCTS TimeOut) applies to every search.
+*/
+void EXPERIMENT::ParallelBenchmark()
+{
+    const char* modes[] = {"Serial", "Root", "Tree"};
+    int numThreads = SearchParams.NumThreads > 1 ? SearchParams.NumThreads : 4;
+    MCTS::PARAMS params = SearchParams;
+
+    cout << "Parallel benchmark with " << numThreads << " threads" << endl;
+    OutputFile << "Sims\tMode\tThreads\tRuns\tSims/s\tError\tValue\tError\n";
+
+    params.MaxDepth = Simulator.GetHorizon(ExpParams.Accuracy, ExpParams.UndiscountedHorizon);
+
+    for (int i = ExpParams.MinDoubles; i <= ExpParams.MaxDoubles; i++)
+    {
+        params.NumSimulations = 1 << i;
+        params.NumStartStates = 1 << i;
+
+        for (int m = 0; m < 3; m++)
+        {
+            STATISTIC simsPerSecond, value;
+            params.NumThreads = m == 0 ? 1 : numThreads;
+            params.TreeParallel = m == 2;
+
+            for (int n = 0; n < ExpParams.NumRuns; n++)
+            {
+                MCTS mcts(Simulator, params);
+                int action = mcts.SelectAction();
+                simsPerSecond.Add(mcts.GetSimulationsPerSecond());
+                value.Add(mcts.GetActionValue(action));
+            }
+
+            cout << modes[m] << ": " << params.NumSimulations << " simulations, "
+                << simsPerSecond.GetMean() << " +- " << simsPerSecond.GetStdErr() << " sims/s, "
+                << "action value = " << value.GetMean() << " +- " << value.GetStdErr() << endl;
+
+            OutputFile << params.NumSimulations << "\t"
+                << modes[m] << "\t"
+                << params.NumThreads << "\t"
+                << ExpParams.NumRuns << "\t"
+                << std::setprecision(6) << simsPerSecond.GetMean() << "\t"
+                << std::setprecision(4) << simsPerSecond.GetStdErr() << "\t"
+                << std::setprecision(4) << value.GetMean() << "\t"
+                << std::setprecision(4) << value.GetStdErr() << endl;
+        }
+    }
+}
+
+/*
+  Cost of PGS rollouts with simulated (AnalyticPGS off) and analytic (on)
+  action scores. GeneratePGS is timed in both modes on the same states,
+  taken from NumRuns random walks of up to NumSteps steps with a fixed
+  seed, then the search throughput with PGS rollouts is measured on the
+  first decision as in ParallelBenchmark. The simulator is the one the
+  experiment searches with, its knowledge is restored at the end.
+*/
+void EXPERIMENT::PGSBenchmark(SIMULATOR& simulator, const SIMULATOR::KNOWLEDGE& knowledge)
+{
+    const char* modes[] = {"Simulated", "Analytic"};
+    SIMULATOR::KNOWLEDGE modeKnowledge = knowledge;
+    STATISTIC callTime[2];
+    std::vector<int> legal, actions[2];
+    int different = 0;
+
+    cout << "PGS benchmark" << endl;
+    OutputFile << "Sims\tMode\tCalls\tus/call\tError\tRuns\tSims/s\tError\n";
+
+    UTILS::RandomSeed(0);
+    for (int n = 0; n < ExpParams.NumRuns; n++)
+    {
+        HISTORY history;
+        SIMULATOR::STATUS status;
+        STATE* state = simulator.CreateStartState();
+
+        for (int t = 0; t < ExpParams.NumSteps; t++)
+        {
+            for (int m = 0; m < 2; m++)
+            {
+                modeKnowledge.AnalyticPGS = m == 1;
+                simulator.SetKnowledge(modeKnowledge);
+                actions[m].clear();
+
+                auto start = std::chrono::steady_clock::now();
+                simulator.GeneratePGS(*state, history, actions[m], status);
+                std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+                callTime[m].Add(elapsed.count() * 1e6);
+            }
+            if (actions[0] != actions[1])
+                different++;
+
+            legal.clear();
+            simulator.GenerateLegal(*state, history, legal, status);
+            int action = legal[UTILS::Random(legal.size())];
+            int observation;
+            double reward;
+            bool terminal = simulator.Step(*state, action, observation, reward);
+            history.Add(action, observation);
+            if (terminal)
+                break;
+        }
+        simulator.FreeState(state);
+    }
+
+    MCTS::PARAMS params = SearchParams;
+    params.MaxDepth = Simulator.GetHorizon(ExpParams.Accuracy, ExpParams.UndiscountedHorizon);
+
+    for (int i = ExpParams.MinDoubles; i <= ExpParams.MaxDoubles; i++)
+    {
+        params.NumSimulations = 1 << i;
+        params.NumStartStates = 1 << i;
+
+        for (int m = 0; m < 2; m++)
+        {
+            STATISTIC simsPerSecond;
+            modeKnowledge.AnalyticPGS = m == 1;
+            simulator.SetKnowledge(modeKnowledge);
+
+            for (int n = 0; n < ExpParams.NumRuns; n++)
+            {
+                MCTS mcts(simulator, params);
+                mcts.SelectAction();
+                simsPerSecond.Add(mcts.GetSimulationsPerSecond());
+            }
+
+            cout << modes[m] << ": " << callTime[m].GetMean() << " +- " << callTime[m].GetStdErr()
+                << " us per GeneratePGS call, " << params.NumSimulations << " simulations, "
+                << simsPerSecond.GetMean() << " +- " << simsPerSecond.GetStdErr() << " sims/s" << endl;
+
+            OutputFile << params.NumSimulations << "\t"
+                << modes[m] << "\t"
+                << callTime[m].GetCount() << "\t"
+                << std::setprecision(4) << callTime[m].GetMean() << "\t"
+                << std::setprecision(4) << callTime[m].GetStdErr() << "\t"
+                << ExpParams.NumRuns << "\t"
+                << std::setprecision(6) << simsPerSecond.GetMean() << "\t"
+                << std::setprecision(4) << simsPerSecond.GetStdErr() << endl;
+        }
+    }
+
+    cout << "PGS actions differ in " << different << " of " << callTime[0].GetCount() << " states" << endl;
+    simulator.SetKnowledge(knowledge);
+}
+
 //----------------------------------------------------------------------------
@@ -16,6 +16,7 @@ struct RESULTS
     STATISTIC Reward;
     STATISTIC DiscountedReturn;
     STATISTIC UndiscountedReturn;
+    STATISTIC SimulationsSaved; //Per decision, with early stopping
 	 int		  Terminated = 0;
 };
 
@@ -25,6 +26,7 @@ inline void RESULTS::Clear()
     Reward.Clear();
     DiscountedReturn.Clear();
     UndiscountedReturn.Clear();
+    SimulationsSaved.Clear();
 	 Terminated = 0;
 }
 
@@ -58,6 +60,8 @@ public:
     void MultiRun();
     void DiscountedReturn();
     void AverageReward();
+    void ParallelBenchmark();
+    void PGSBenchmark(SIMULATOR& simulator, const SIMULATOR::KNOWLEDGE& knowledge);
 
 private:
 
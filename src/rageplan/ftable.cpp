@@ -10,6 +10,14 @@ void FTABLE::valueUpdate(int action, double value){
 	}
 }
 
+//Add entry values from a table with the same layout, e.g. the copy used by a search worker
+void FTABLE::merge(const FTABLE& ftable){
+	assert(ftable.Table.size() == Table.size());
+	for(int i=0; i < Table.size(); i++){
+		Table[i].value.Merge(ftable.Table[i].value);
+	}
+}
+
 void FTABLE::inactivityUpdate(){
 	for(int i=0; i < Table.size(); i++){	
 		Table[i].value.Add(-10);
@@ -41,6 +41,12 @@ public:
         Total += totalReward * weight;
     }
 	 
+    void Merge(const FVALUE& value)
+    {
+        Count += value.Count;
+        Total += value.Total;
+    }
+	 
 	 /*
 		Learning rate value add, must track a non-stationary value
 	 */
@@ -85,6 +91,7 @@ public:
 	};
 
 	void valueUpdate(int action, double value); //Update all entries in tables for action a with value v
+	void merge(const FTABLE& ftable); //Add values gathered by a parallel search worker (same entries)
 	//void validateTable(); //(De)Activate features according to their f-values
 
 	/* Action/feature info */
@@ -3,17 +3,11 @@
 
 #include <iomanip>
 #include <fstream>
+#include <type_traits>
 
 using namespace std;
 using namespace UTILS;
 
-void HOTEL_ROBOT_STATE::activateFeature(int feature, bool status){
-    if(feature >= NumTypes && feature < containers.size()){
-        containers[feature - NumTypes].active = status;
-    }
-}
-
-
 /* Build Ftable mapping every action to its affected feature/object */
 /*
     In Mobipick, actions afforded by objects are: pick object, identify object
@@ -81,7 +75,7 @@ HOTEL_ROBOT::HOTEL_ROBOT(PROBLEM_PARAMS& problem_params, HOTEL_PARAMS& ap){
     NumPoses = poses_str.size();
     NumOutcomes = outcomes_str.size(); //FAIL, OK
     
-    NumFeatures = NumContainers; //All storage units/parts
+    NumFeatures = NumTypes + NumContainers; //Feature ids of containers follow the types, see initializeFTable
     NumActions = (1 + 1 + 1) + NumContainers; //Perceive (worker, hotel type, containers) + bring each part
     
     NumObservations = pow(2,NumContainers); //MAX obs = all part combinations
@@ -112,6 +106,12 @@ HOTEL_ROBOT::HOTEL_ROBOT(PROBLEM_PARAMS& problem_params, HOTEL_PARAMS& ap){
 
     //Parts in both A and B -> generalParts
     std::set_intersection(hotelA.begin(), hotelA.end(), hotelB.begin(), hotelB.end(), std::inserter(generalParts, generalParts.begin()));
+
+    for(int t=0; t < 2; t++){
+        uniqueMask[t] = 0;
+        for(auto p : uniqueParts[t])
+            uniqueMask[t] |= 1 << p;
+    }
     
     hotelA.clear();
     hotelB.clear();
@@ -121,6 +121,15 @@ HOTEL_ROBOT::HOTEL_ROBOT(PROBLEM_PARAMS& problem_params, HOTEL_PARAMS& ap){
     InitGeneral();
 }
 
+HOTEL_ROBOT* HOTEL_ROBOT::Create(PROBLEM_PARAMS& problem_params, HOTEL_PARAMS& ap)
+{
+    if(ap.n_parts == 5 && ap.n_types == 2)
+        return new HOTEL_ROBOT_T<5, 2>(problem_params, ap);
+    if(ap.n_parts == 8 && ap.n_types == 2)
+        return new HOTEL_ROBOT_T<8, 2>(problem_params, ap);
+    return new HOTEL_ROBOT(problem_params, ap);
+}
+
 void HOTEL_ROBOT::InitGeneral()
 {    
     //RandomSeed(time(NULL));
@@ -131,11 +140,177 @@ void HOTEL_ROBOT::InitGeneral()
 STATE* HOTEL_ROBOT::Copy(const STATE& state) const
 {        
     const HOTEL_ROBOT_STATE& robotState = safe_cast<const HOTEL_ROBOT_STATE&>(state);    
+    static_assert(std::is_trivially_copyable<HOTEL_ROBOT_STATE>::value, "HOTEL_ROBOT_STATE must copy as one block");
     HOTEL_ROBOT_STATE* newstate = MemoryPool.Allocate();    
     *newstate = robotState;    
     return newstate;
 }
 
+// Hash of the variables that differ between particles, see Equal
+std::size_t HOTEL_ROBOT::Hash(const STATE& state) const
+{
+    const HOTEL_ROBOT_STATE& rState = safe_cast<const HOTEL_ROBOT_STATE&>(state);
+    std::size_t hash = 1;
+    HashCombine(hash, rState.workerState.action);
+    HashCombine(hash, rState.workerState.object);
+    HashCombine(hash, rState.workerState.result);
+    HashCombine(hash, rState.workerState.hotelStage);
+    HashCombine(hash, rState.workerState.hotel);
+    for(const auto& p : rState.workerState.allParts)
+        HashCombine(hash, p.assembled);
+    for(const auto& h : rState.workerState.hotels)
+        HashCombine(hash, h.type);
+    HashCombine(hash, rState.available);
+    for(const auto& o : rState.po_objects)
+        HashCombine(hash, o.LikelihoodT0);
+    for(const auto& c : rState.containers){
+        HashCombine(hash, c.needed);
+        HashCombine(hash, c.LikelihoodEmpty);
+        HashCombine(hash, c.LikelihoodAssembled);
+    }
+    for(bool status : rState.containerStatus)
+        HashCombine(hash, status);
+    return hash;
+}
+
+bool HOTEL_ROBOT::Equal(const STATE& state1, const STATE& state2) const
+{
+    const HOTEL_ROBOT_STATE& s1 = safe_cast<const HOTEL_ROBOT_STATE&>(state1);
+    const HOTEL_ROBOT_STATE& s2 = safe_cast<const HOTEL_ROBOT_STATE&>(state2);
+    return s1.workerState == s2.workerState && s1.NumTypes == s2.NumTypes &&
+        s1.available == s2.available && s1.po_objects == s2.po_objects &&
+        s1.containers == s2.containers && s1.storage == s2.storage &&
+        s1.containerStatus == s2.containerStatus && s1.p_empty == s2.p_empty;
+}
+
+// KLD bins: hotel types and the true part and container status
+std::size_t HOTEL_ROBOT::Discretise(const STATE& state) const
+{
+    const HOTEL_ROBOT_STATE& rState = safe_cast<const HOTEL_ROBOT_STATE&>(state);
+    std::size_t bin = 1;
+    HashCombine(bin, rState.workerState.hotel);
+    for(const auto& h : rState.workerState.hotels)
+        HashCombine(bin, h.type);
+    for(const auto& p : rState.workerState.allParts)
+        HashCombine(bin, p.assembled);
+    for(bool status : rState.containerStatus)
+        HashCombine(bin, status);
+    return bin;
+}
+
+/* Factored belief: container status and hotel type are redrawn from the
+ * marginals kept in the state (p_empty, ProbT0), the worker's stage stays
+ * with the particle. Variables the worker's progress already determines
+ * are kept: containers of assembled parts (taking the part emptied them)
+ * and the type once a part unique to one type is assembled.
+ * This is an approximation, not the exact posterior: p_empty ignores the
+ * worker taking parts, and redrawing loses the correlation between these
+ * variables and the worker's progress. It costs return at every cap.
+ */
+bool HOTEL_ROBOT::SampleFactors(STATE& state) const
+{
+    HOTEL_ROBOT_STATE& rState = safe_cast<HOTEL_ROBOT_STATE&>(state);
+
+    for(int c=0; c < NumContainers; c++){
+        if(rState.workerState.allParts[c].assembled || rState.p_empty[c] == 0.5) continue;
+        rState.containerStatus[c] = !Bernoulli(rState.p_empty[c]);
+        rState.containers[c].empty = !rState.containerStatus[c];
+    }
+
+    //STRONG ASSUMPTION: ONLY TWO HOTEL TYPES, as in InspectObject
+    bool revealed = (rState.workerState.assembled & (uniqueMask[0] | uniqueMask[1])) != 0;
+    int hotel = rState.workerState.hotel;
+    if(!revealed && rState.po_objects[hotel].ProbT0 != 0.5){
+        rState.workerState.hotels[hotel].type = Bernoulli(rState.po_objects[hotel].ProbT0) ? 0 : 1;
+    }
+
+    return true;
+}
+
+/* Packed particle: worker stage, hotel types and the boolean status of
+ * parts and containers as bit fields, beliefs as doubles. Names, costs,
+ * storage and the unused low flags never change and come from the
+ * particle Unpack overwrites.
+ */
+bool HOTEL_ROBOT::Pack(const STATE& state, BIT_WRITER& bits, vector<double>& probs) const
+{
+    const HOTEL_ROBOT_STATE& rState = safe_cast<const HOTEL_ROBOT_STATE&>(state);
+
+    bits.PutInt(rState.workerState.action);
+    bits.PutInt(rState.workerState.object);
+    bits.PutInt(rState.workerState.result);
+    bits.PutInt(rState.workerState.hotelStage);
+    bits.PutInt(rState.workerState.hotel);
+    for(const auto& h : rState.workerState.hotels){
+        bits.Put(h.type, 8);
+        bits.Put(h.complete, 1);
+        probs.push_back(h.percentageComplete);
+    }
+    for(const auto& p : rState.workerState.allParts)
+        bits.Put(p.assembled, 1);
+    bits.Put(rState.available, 1);
+
+    for(const auto& o : rState.po_objects){
+        bits.Put(o.assumedType, 1);
+        probs.push_back(o.ProbT0);
+        probs.push_back(o.LikelihoodT0);
+        probs.push_back(o.LikelihoodNotT0);
+    }
+    for(int c=0; c < rState.containers.size(); c++){
+        const HOTEL_ROBOT_STATE::ELEMENT& e = rState.containers[c];
+        bits.Put(e.needed, 1);
+        bits.Put(e.empty, 1);
+        bits.Put(rState.containerStatus[c], 1);
+        probs.push_back(e.LikelihoodEmpty);
+        probs.push_back(e.LikelihoodNotEmpty);
+        probs.push_back(e.ProbEmpty);
+        probs.push_back(e.LikelihoodAssembled);
+        probs.push_back(e.LikelihoodNotAssembled);
+        probs.push_back(e.ProbAssembled);
+        probs.push_back(rState.p_empty[c]);
+    }
+    return true;
+}
+
+void HOTEL_ROBOT::Unpack(BIT_READER& bits, const double* probs, STATE& state) const
+{
+    HOTEL_ROBOT_STATE& rState = safe_cast<HOTEL_ROBOT_STATE&>(state);
+
+    rState.workerState.action = bits.GetInt();
+    rState.workerState.object = bits.GetInt();
+    rState.workerState.result = bits.GetInt();
+    rState.workerState.hotelStage = bits.GetInt();
+    rState.workerState.hotel = bits.GetInt();
+    for(auto& h : rState.workerState.hotels){
+        h.type = bits.Get(8);
+        h.complete = bits.Get(1);
+        h.percentageComplete = *probs++;
+    }
+    for(int p=0; p < rState.workerState.allParts.size(); p++)
+        rState.workerState.setAssembled(p, bits.Get(1));
+    rState.available = bits.Get(1);
+
+    for(auto& o : rState.po_objects){
+        o.assumedType = bits.Get(1);
+        o.ProbT0 = *probs++;
+        o.LikelihoodT0 = *probs++;
+        o.LikelihoodNotT0 = *probs++;
+    }
+    for(int c=0; c < rState.containers.size(); c++){
+        HOTEL_ROBOT_STATE::ELEMENT& e = rState.containers[c];
+        e.needed = bits.Get(1);
+        e.empty = bits.Get(1);
+        rState.containerStatus[c] = bits.Get(1);
+        e.LikelihoodEmpty = *probs++;
+        e.LikelihoodNotEmpty = *probs++;
+        e.ProbEmpty = *probs++;
+        e.LikelihoodAssembled = *probs++;
+        e.LikelihoodNotAssembled = *probs++;
+        e.ProbAssembled = *probs++;
+        rState.p_empty[c] = *probs++;
+    }
+}
+
 void HOTEL_ROBOT::Validate(const STATE& state) const
 {
     const HOTEL_ROBOT_STATE& robotState = safe_cast<const HOTEL_ROBOT_STATE&>(state);
@@ -157,6 +332,7 @@ STATE* HOTEL_ROBOT::CreateStartState() const
     state->NumTypes = NumTypes;
     
     //PO Hotels, all initially unknown types
+    state->po_objects.clear(); //Pooled states keep their old vectors
     for(int i=0; i < NumObjects; i++){
         HOTEL_ROBOT_STATE::PO_OBJ po_hotel;
         
@@ -172,11 +348,9 @@ STATE* HOTEL_ROBOT::CreateStartState() const
     state->containers.clear();
     //state->storage.clear();
     state->containerStatus.clear();
+    state->p_empty.clear();
     
-    //Create parts/containers        
-    bool names = false;    
-    if(parts_str.size() == NumContainers) names = true;
-    
+    //Create parts/containers (names are in parts_str)
     //*** This version uses no declared storage ***/
     //bool initStorage;
     //if(initial_storage.size() == NumContainers) initStorage = true;
@@ -194,11 +368,6 @@ STATE* HOTEL_ROBOT::CreateStartState() const
         
         //FO
         e.id = i;
-        if(names)
-            e.name = parts_str[i];
-        else
-            e.name = "Part " + std::to_string(e.id);
-        
         e.capacity = 15; //TODO: determine max capacity separately or externally. Currently not used.
         e.cost = part_cost[i]; 
         e.priority = part_priority[i];
@@ -207,6 +376,7 @@ STATE* HOTEL_ROBOT::CreateStartState() const
         e.count = 0;
         
         e.needed = false;
+        e.low = false;
         e.empty = Bernoulli(0.5); //Container status unknown, initialized randomly
         state->containerStatus.push_back(!e.empty); //Based on the above
         state->p_empty.push_back(0.5); //same as ProbEmpty but shareable
@@ -219,9 +389,6 @@ STATE* HOTEL_ROBOT::CreateStartState() const
         e.LikelihoodAssembled = 1.0;
         e.LikelihoodNotAssembled = 1.0;
         e.ProbAssembled = 0.5;
-
-        //IRE
-        e.active = true;
         
         //Add PO object
         state->containers.push_back(e);        
@@ -256,24 +423,28 @@ bool HOTEL_ROBOT::Step(STATE& state, int action,
  * where phi(s) = alpha*PGS(s) and gamma = 1
  *
 */
+template<int NP>
 bool HOTEL_ROBOT::StepPGS(STATE& state, int action,
                      int& observation, double& reward) const
 {
    double scale = 10.0;
     double r = 0.0;
     double r2 = 0.0;
-    STATE* oldstate = Copy(state);
+    HOTEL_ROBOT_STATE& rState = safe_cast<HOTEL_ROBOT_STATE&>(state);
 
-    bool terminal = StepNormal(state, action, observation, reward);
+    //Old potential and the old terms of PGS_RO, taken before the step instead of copying the state
+    r2 = PGS<NP>(state);
+    PGS_BEFORE before;
+    PGSBefore<NP>(rState, action, before);
+
+    bool terminal = StepNormal<NP>(state, action, observation, reward);
 
     // Potential-based reward bonus
     //if(!terminal){//Not terminal or out of bounds
-        r2 = PGS(*oldstate);
-        r = PGS_RO(*oldstate, state, action, r2); //PGS(state);
+        r = PGSAfter<NP>(rState, action, before, r2); //PGS(state);
         
         reward += PGSAlpha*r - PGSAlpha*r2;        
     //}
-    FreeState(oldstate);
 
     return terminal;
 }
@@ -282,7 +453,7 @@ bool HOTEL_ROBOT::StepPGS(STATE& state, int action,
     Worker simulation. Advances the MC/MDP policy
 */
 
-bool HOTEL_ROBOT::simulateWorker(HOTEL_STATE& state, vector<bool>& storage, double& workerReward) const{
+bool HOTEL_ROBOT::simulateWorker(HOTEL_STATE& state, HOTEL_STORAGE& storage, double& workerReward) const{
     //Simulate transition
 	bool done = worker.Step(state);
     //Simulate/populate non-deterministic outcomes    
@@ -295,6 +466,7 @@ bool HOTEL_ROBOT::simulateWorker(HOTEL_STATE& state, vector<bool>& storage, doub
 /*
  * Regular step function.  Simulates transition from state with action and returns observation and reward
 */
+template<int NP>
 bool HOTEL_ROBOT::StepNormal(STATE& state, int action,
                         int& observation, double& reward) const
 {    
@@ -396,8 +568,8 @@ bool HOTEL_ROBOT::StepNormal(STATE& state, int action,
             bool assembled = rState.workerState.allParts[part].assembled; //rState.containers[part].ProbAssembled > 0.5;
 
             //5. Is part unique?
-            bool uniqueA = contains(uniqueParts[0], part);
-            bool uniqueB = contains(uniqueParts[1], part);
+            bool uniqueA = (uniqueMask[0] >> part) & 1;
+            bool uniqueB = (uniqueMask[1] >> part) & 1;
             //5.1 Do we know the hotel type?
             bool typeKnown = rState.po_objects[rState.workerState.hotel].assumedType;
             //5.2 Does the type match with A or B?
@@ -449,13 +621,11 @@ bool HOTEL_ROBOT::StepNormal(STATE& state, int action,
         //Receive observation
         //double efficiency = InspectContainer(rState, container, observation);
 
-        std::vector<bool> obs; //Observation tuple
-        double efficiency = InspectAllContainers(rState, obs); //Generate observation
-        observation = getObservationIndex(obs); //Convert to index
+        double efficiency = InspectAllContainers<NP>(rState, observation); //Generate observation bits
         
-        for(int container=0; container < NumContainers; container++){
+        for(int container=0; container < Parts<NP>(); container++){
             //update info about containers
-            if(obs[container]){ //OK, Container > 0
+            if(observation & ObsBit<NP>(container)){ //OK, Container > 0
                 //Estimate prob. of container NOT being empty
                 rState.containers[container].LikelihoodNotEmpty *= efficiency;
                 rState.containers[container].LikelihoodEmpty *= 1 - efficiency;
@@ -507,13 +677,11 @@ bool HOTEL_ROBOT::StepNormal(STATE& state, int action,
     ///Perceive HOTEL STATUS/PROGRESS, by receiving a binary part array
     else if(action == A_PERCEIVE){
         reward = reward_perceive;
-        std::vector<bool> obs; //Observation tuple
-        double efficiency = Perceive(rState, obs); //Generate observation
-        observation = getObservationIndex(obs); //Convert to index
+        double efficiency = Perceive<NP>(rState, observation); //Generate observation bits
         
         //iterate over detected assembled parts and update their likelihood/prob
-        for(int i=0; i < NumContainers; i++){
-            bool ass = obs[i]; //Is the current part assembled?
+        for(int i=0; i < Parts<NP>(); i++){
+            bool ass = observation & ObsBit<NP>(i); //Is the current part assembled?
             if(ass){
                 rState.containers[i].LikelihoodAssembled *= efficiency;
                 rState.containers[i].LikelihoodNotAssembled *= 1 - efficiency;
@@ -588,11 +756,8 @@ bool HOTEL_ROBOT::LocalMove(STATE& state, const HISTORY& history, int stepObs, c
             //int container = action - A_INSPECT_CONTAINER;
             int realObs = history.Back().Observation; //External observation
                                 
-            std::vector<bool> newObsA;
-            InspectAllContainers(rState, newObsA); //Inspect previous container after random change
-            int newObs = getObservationIndex(newObsA);
-            
-            newObsA.clear();
+            int newObs;
+            InspectAllContainers(rState, newObs); //Inspect previous container after random change
 
             if(realObs != newObs)
                 return false;
@@ -604,16 +769,14 @@ bool HOTEL_ROBOT::LocalMove(STATE& state, const HISTORY& history, int stepObs, c
         int hotelPart = Random(rState.workerState.allParts.size());
 
         //Change assembly status of random part (from ALL parts)
-        rState.workerState.allParts[hotelPart].assembled = !rState.workerState.allParts[hotelPart].assembled;
+        rState.workerState.setAssembled(hotelPart, !rState.workerState.allParts[hotelPart].assembled);
         
         //Validate perceive worker
         if (action == A_PERCEIVE){
             int realObs = history.Back().Observation; //External observation
             
-            std::vector<bool> newT;
-            Perceive(rState, newT);
-            int newObs = getObservationIndex(newT);
-            newT.clear();
+            int newObs;
+            Perceive(rState, newObs);
 
             if(realObs != newObs)
                 return false;
@@ -639,48 +802,140 @@ bool HOTEL_ROBOT::LocalMove(STATE& state, const HISTORY& history, int stepObs, c
     return true;
 }
 
+/* Observation likelihood under the confidence perception reports for each
+ * observation bit (STATUS::ObsConfidence, one value applies to all bits),
+ * relative to the most likely observation. Without confidences observations
+ * must match exactly. Where stepObs differs, the smart knowledge Step updated
+ * is redone with the real observation.
+ */
+double HOTEL_ROBOT::ObservationLikelihood(STATE& state, const HISTORY& history, int stepObs, const STATUS& status) const{
+    int action = history.Back().Action;
+    int realObs = history.Back().Observation;
+    const std::vector<double>& confidence = status.ObsConfidence;
+
+    if(confidence.empty() || (action != A_PERCEIVE && action != A_INSPECT_CONTAINER && action != A_INSPECT_OBJECT))
+        return stepObs == realObs ? 1.0 : 0.0;
+
+    HOTEL_ROBOT_STATE& rState = safe_cast<HOTEL_ROBOT_STATE&>(state);
+    double efficiency = PERCEIVE_ACC;
+    bool redo = stepObs != realObs && efficiency > 0 && efficiency < 1;
+    double ratio = (1 - efficiency) / efficiency;
+    double likelihood = 1.0;
+
+    //Hotel type: 0 = ambiguous, 1 = type A, 2 = type B
+    if(action == A_INSPECT_OBJECT){
+        double c = confidence[0];
+        likelihood = (stepObs == realObs ? c : 1 - c) / std::max(c, 1 - c);
+
+        if(redo){
+            HOTEL_ROBOT_STATE::PO_OBJ& hotel = rState.po_objects[rState.workerState.hotel];
+            //Undo the update for stepObs, then apply realObs
+            if(stepObs == 1){ hotel.LikelihoodT0 /= efficiency; hotel.LikelihoodNotT0 /= 1 - efficiency; }
+            else if(stepObs == 2){ hotel.LikelihoodT0 /= 1 - efficiency; hotel.LikelihoodNotT0 /= efficiency; }
+            if(realObs == 1){ hotel.LikelihoodT0 *= efficiency; hotel.LikelihoodNotT0 *= 1 - efficiency; }
+            else if(realObs == 2){ hotel.LikelihoodT0 *= 1 - efficiency; hotel.LikelihoodNotT0 *= efficiency; }
+
+            double denom = (0.5 * hotel.LikelihoodT0) + (0.5 * hotel.LikelihoodNotT0);
+            hotel.ProbT0 = (0.5 * hotel.LikelihoodT0) / denom;
+            if(!hotel.assumedType && BinEntropyCheck(hotel.ProbT0))
+                hotel.assumedType = true;
+        }
+        return likelihood;
+    }
+
+    //Bit arrays: parts assembled (perceive) or containers not empty (inspect)
+    for(int i=0; i < NumContainers; i++){
+        bool stepBit = stepObs & ObsBit<0>(i);
+        bool realBit = realObs & ObsBit<0>(i);
+        double c = confidence[std::min<int>(i, confidence.size() - 1)];
+        likelihood *= (stepBit == realBit ? c : 1 - c) / std::max(c, 1 - c);
+
+        if(!redo || stepBit == realBit)
+            continue;
+
+        //Step multiplied the likelihood of the observed value by efficiency, swap it over
+        double toReal = realBit ? 1.0 / ratio : ratio;
+        HOTEL_ROBOT_STATE::ELEMENT& e = rState.containers[i];
+        if(action == A_PERCEIVE){
+            e.LikelihoodAssembled = std::max(0.001, e.LikelihoodAssembled * toReal);
+            e.LikelihoodNotAssembled = std::max(0.001, e.LikelihoodNotAssembled / toReal);
+            double denom = (0.5 * e.LikelihoodAssembled) + (0.5 * e.LikelihoodNotAssembled);
+            e.ProbAssembled = (0.5 * e.LikelihoodAssembled) / denom;
+        }
+        else{
+            e.LikelihoodNotEmpty *= toReal;
+            e.LikelihoodEmpty /= toReal;
+            double denom = (0.5 * e.LikelihoodEmpty) + (0.5 * e.LikelihoodNotEmpty);
+            e.ProbEmpty = (0.5 * e.LikelihoodEmpty) / denom;
+            rState.p_empty[i] = e.ProbEmpty;
+        }
+    }
+    return likelihood;
+}
+
 /* Fast PGS for Rollout policy
  * Simplified PGS point count by using only the specific action changes
  */
+template<int NP>
 double HOTEL_ROBOT::PGS_RO(STATE& oldstate, STATE& state, int action, double oldpgs) const
+{
+	PGS_BEFORE before;
+	PGSBefore<NP>(safe_cast<HOTEL_ROBOT_STATE&>(oldstate), action, before);
+	return PGSAfter<NP>(safe_cast<HOTEL_ROBOT_STATE&>(state), action, before, oldpgs);
+}
+
+/* Old-state terms of PGS_RO */
+template<int NP>
+void HOTEL_ROBOT::PGSBefore(const HOTEL_ROBOT_STATE& oldRState, int action, PGS_BEFORE& before) const
+{
+    before.points = 0.0;
+
+	//2. Remove neg. point if container status changed
+	if(action >= A_BRING_PARTS){
+        int part = action - A_BRING_PARTS;
+        if(oldRState.containers[part].needed){
+            before.points += PGS_notgoal;
+        }
+    }
+
+    //3. Hotel type uncertainty, the worker may move on to the next hotel during the step
+    before.hotel = oldRState.workerState.hotel;
+    before.hotelUncertain = action == A_INSPECT_OBJECT && !BinEntropyCheck(oldRState.po_objects[before.hotel].ProbT0);
+
+    //4. Container uncertainty
+    if(action == A_INSPECT_CONTAINER){
+        for(int c=0; c < Parts<NP>(); c++)
+            if (!BinEntropyCheck(oldRState.p_empty[c])) before.points += PGS_uncertain;
+    }
+}
+
+/* PGS_RO from the new state and the terms taken before the step */
+template<int NP>
+double HOTEL_ROBOT::PGSAfter(const HOTEL_ROBOT_STATE& rState, int action, const PGS_BEFORE& before, double oldpgs) const
 {
     double points = 0.0;
-	double oldpoints = 0.0;
-	
-	//Cast to local state
-	HOTEL_ROBOT_STATE& rState = safe_cast<HOTEL_ROBOT_STATE&>(state);
-	HOTEL_ROBOT_STATE& oldRState = safe_cast<HOTEL_ROBOT_STATE&>(oldstate);
+	double oldpoints = before.points;
 	      
     //1. +1 for assembling a hotel
-    int t = 0;
 	if(rState.workerState.action == worker.A_NONE && rState.workerState.result == worker.O_DONE){
         points += PGS_goal;
         oldpoints += PGS_uncertain;
 	}
-	
-	//2. Remove neg. point if container status changed
-	if(action >= A_BRING_PARTS){
-        int part = action - A_BRING_PARTS;
-        if(oldRState.containers[part].needed){
-            oldpoints += PGS_notgoal;
-        }
-    }
 
     //3. Remove point if hotel type uncertainty is lifted
     if(action == A_INSPECT_OBJECT){
         int hotel = rState.workerState.hotel;
         if( !BinEntropyCheck(rState.po_objects[hotel].ProbT0) ) points += PGS_uncertain;
 
-        if( !BinEntropyCheck(oldRState.po_objects[hotel].ProbT0) ) oldpoints += PGS_uncertain;
+        //Only the current hotel is inspected, any other one kept its old type estimate
+        bool oldUncertain = hotel == before.hotel ? before.hotelUncertain : !BinEntropyCheck(rState.po_objects[hotel].ProbT0);
+        if( oldUncertain ) oldpoints += PGS_uncertain;
     }
 
     //4. Remove point if container uncertainty if lifted
     if(action == A_INSPECT_CONTAINER){
-        //int container = action - A_INSPECT_CONTAINER;
-        for(auto container : rState.p_empty)
-            if (!BinEntropyCheck(container)) points += PGS_uncertain;
-        for(auto oldContainer : oldRState.p_empty)
-            if (!BinEntropyCheck(oldContainer)) oldpoints += PGS_uncertain;
+        for(int c=0; c < Parts<NP>(); c++)
+            if (!BinEntropyCheck(rState.p_empty[c])) points += PGS_uncertain;
     }
 
 	//Update difference
@@ -692,6 +947,7 @@ double HOTEL_ROBOT::PGS_RO(STATE& oldstate, STATE& state, int action, double old
 /*
  * PGS Point scoring for the INCORAP domain
  */
+template<int NP>
 double HOTEL_ROBOT::PGS(STATE& state) const
 {    
     double points = 0.0;
@@ -715,8 +971,8 @@ double HOTEL_ROBOT::PGS(STATE& state) const
     }*/
     
     //2. -1 for each empty but needed container
-    for(auto c : rState.containers){
-        if(c.needed) points += PGS_notgoal;
+    for(int c=0; c < Parts<NP>(); c++){
+        if(rState.containers[c].needed) points += PGS_notgoal;
     }
 
     //3. Hotel type uncertainty    
@@ -725,8 +981,8 @@ double HOTEL_ROBOT::PGS(STATE& state) const
     }
 
     //4. Container status uncertainty
-    for(auto p : rState.p_empty){
-        if(!BinEntropyCheck(p)) points += PGS_uncertain;
+    for(int c=0; c < Parts<NP>(); c++){
+        if(!BinEntropyCheck(rState.p_empty[c])) points += PGS_uncertain;
     }
 	
 	return points;
@@ -736,18 +992,30 @@ double HOTEL_ROBOT::PGS(STATE& state) const
 void HOTEL_ROBOT::GeneratePGS(const STATE& state, const HISTORY& history,
                          vector<int>& legal, const STATUS& status) const
 {
-    static vector<int> acts;
+    GeneratePGSSized<0, 0>(state, history, legal, status);
+}
+
+template<int NP, int NT>
+void HOTEL_ROBOT::GeneratePGSSized(const STATE& state, const HISTORY& history,
+                         vector<int>& legal, const STATUS& status) const
+{
+    static thread_local vector<int> acts;
 	acts.clear();
-	STATE * newstate;
-	STATE * oldstate = Copy(state);
-	PGSLegal(state, history, acts, status);
+	PGSLegal<NP, NT>(state, history, acts, status);
 	int numLegal = acts.size();
 	
 	double pgs_values[numLegal]; //pgs_values[i] <-- legalMove[i]
-	double pgs_state = PGS(*oldstate);
-		
-	int max_p = -1;
-	double max_v = -Infinity;	
+
+	//Score actions from the state alone, PGS(state) is the same for all of them
+	if(Knowledge.AnalyticPGS){
+		PGSDeltasSized<NP>(safe_cast<const HOTEL_ROBOT_STATE&>(state), acts, pgs_values);
+		AddBestPGS(acts, pgs_values, legal);
+		return;
+	}
+
+	STATE * newstate;
+	STATE * oldstate = Copy(state);
+	double pgs_state = PGS<NP>(*oldstate);
 	
 	int observation;
 	double reward;
@@ -758,34 +1026,81 @@ void HOTEL_ROBOT::GeneratePGS(const STATE& state, const HISTORY& history,
 	for(unsigned int i=0; i<numLegal; i++){		
 		newstate = Copy(state);
 		
-		StepNormal(*newstate, acts[i], observation, reward); //Simulate transition with action a
+		StepNormal<NP>(*newstate, acts[i], observation, reward); //Simulate transition with action a
 		
 		// Using regular PGS (slow)
 		//pgs_values[i] = PGS(*newstate);
 		
 		// Adding only PGS differences (fast)
-		pgs_values[i] = PGS_RO(*oldstate, *newstate, acts[i], pgs_state); //add differences
+		pgs_values[i] = PGS_RO<NP>(*oldstate, *newstate, acts[i], pgs_state); //add differences
 
 		FreeState(newstate);
 	}
 	
 	FreeState(oldstate);
-	max_p = std::distance(pgs_values, max_element(pgs_values, pgs_values+numLegal));
-	max_v = pgs_values[max_p];
-	assert(max_p > -1);
-	
-	legal.push_back(acts[max_p]); //Add best action to return vector
-	// Add other maxima
-	for(int i=0; i<numLegal; i++){
-		if(i != max_p && pgs_values[i] == max_v)
-            legal.push_back(acts[i]);
-	}
+	AddBestPGS(acts, pgs_values, legal); //Best action first, then the other maxima
+}
+
+bool HOTEL_ROBOT::PGSDeltas(const STATE& state, const vector<int>& actions, double* deltas) const
+{
+    PGSDeltasSized<0>(safe_cast<const HOTEL_ROBOT_STATE&>(state), actions, deltas);
+    return true;
+}
+
+/* Expected PGS_RO change of each action, over the observations it can return.
+ * Worker progress during the step (hotel completion) is left out, it does not
+ * depend on the robot action
+ */
+template<int NP>
+void HOTEL_ROBOT::PGSDeltasSized(const HOTEL_ROBOT_STATE& rState, const vector<int>& actions, double* deltas) const
+{
+    double efficiency = PERCEIVE_ACC;
+    const auto& hotel = rState.po_objects[rState.workerState.hotel];
+
+    for(int i=0; i < actions.size(); i++){
+        int action = actions[i];
+        double delta = 0.0;
+
+        //2. Bringing a needed part removes its neg. point, whatever the outcome
+        if(action >= A_BRING_PARTS){
+            if(rState.containers[action - A_BRING_PARTS].needed)
+                delta -= PGS_notgoal;
+        }
+        //3. Hotel type uncertainty, see InspectObject
+        else if(action == A_INSPECT_OBJECT){
+            bool uniquePartsA = (rState.workerState.assembled & uniqueMask[0]) != 0;
+            bool uniquePartsB = (rState.workerState.assembled & uniqueMask[1]) != 0;
+
+            //Conflicts return obs = 0 and leave the estimate as it is
+            if(uniquePartsA != uniquePartsB){
+                int trueType = rState.workerState.hotels[rState.workerState.hotel].type;
+                double pT0 = trueType == 0 ? efficiency : 1 - efficiency; //p(obs = 1)
+                double uncertain = pT0 * !BinEntropyCheck(BinaryPosterior(hotel.LikelihoodT0, hotel.LikelihoodNotT0, efficiency, true))
+                                + (1 - pT0) * !BinEntropyCheck(BinaryPosterior(hotel.LikelihoodT0, hotel.LikelihoodNotT0, efficiency, false));
+                delta = PGS_uncertain * (uncertain - !BinEntropyCheck(hotel.ProbT0));
+            }
+        }
+        //4. Container uncertainty, see InspectAllContainers: each bit is flipped with p((1 - efficiency) / parts)
+        else if(action == A_INSPECT_CONTAINER){
+            double pFlip = (1 - efficiency) / Parts<NP>();
+            for(int c=0; c < Parts<NP>(); c++){
+                const auto& container = rState.containers[c];
+                double pEmpty = rState.containerStatus[c] ? pFlip : 1 - pFlip; //p(bit = 0)
+                double uncertain = pEmpty * !BinEntropyCheck(BinaryPosterior(container.LikelihoodEmpty, container.LikelihoodNotEmpty, efficiency, true))
+                                + (1 - pEmpty) * !BinEntropyCheck(BinaryPosterior(container.LikelihoodEmpty, container.LikelihoodNotEmpty, efficiency, false));
+                delta += PGS_uncertain * (uncertain - !BinEntropyCheck(rState.p_empty[c]));
+            }
+        }
+
+        deltas[i] = delta;
+    }
 }
 
 /*
  * Legal actions following PGS policy: avoid actions that do not reduce uncertainty
 */
 
+template<int NP, int NT>
 void HOTEL_ROBOT::PGSLegal(const STATE& state, const HISTORY& history,
                       vector<int>& legal, const STATUS& status) const
 {
@@ -806,8 +1121,8 @@ void HOTEL_ROBOT::PGSLegal(const STATE& state, const HISTORY& history,
     //Selectively allow restocking containers
 
     //IDEA: prefer general parts, and bring exclusive parts if they match known hotel type
-    for(int o=0; o < NumContainers; o++){        
-        if(rState.containers[o].active){
+    for(int o=0; o < Parts<NP>(); o++){        
+        if(IsActive(o + Types<NT>())){
             //NOT ALLOWING inspect container yielded good results BEFORE
             //legal.push_back(A_INSPECT_CONTAINER + o);
             legal.push_back(A_BRING_PARTS + o);
@@ -834,31 +1149,27 @@ void HOTEL_ROBOT::GeneratePreferred(const STATE& state, const HISTORY& history,
 
 ///// Domain specific //////
 
-//Simple wrapper
-bool HOTEL_ROBOT::contains(vector<int> v, int element) const{
-    return std::find(v.begin(), v.end(), element) != v.end();
-}
-
 /*
  * Hotel Perceive looks at "activities" through the hotel progress.
  * We simulate by generating a boolean array that describes which hotel parts are present, as
  * perceived by the camera/image processing part.
  * 
  */
-double HOTEL_ROBOT::Perceive(const HOTEL_ROBOT_STATE& state, std::vector<bool>& obs) const{
+template<int NP>
+double HOTEL_ROBOT::Perceive(const HOTEL_ROBOT_STATE& state, int& obs) const{
     double efficiency = PERCEIVE_ACC; //Maybe calculate based on state properties
     double pm_efficiency = 1-efficiency;
-    obs.resize(NumContainers);
+    obs = 0;
 	    
-    //With given efficiency, observe presence or absence of all possible parts
-	for(auto p : state.workerState.allParts)
-        obs[p.number] = p.assembled;
+    //With given efficiency, observe presence or absence of all possible parts (allParts[i].number == i)
+	for(int i=0; i < Parts<NP>(); i++)
+        if(state.workerState.allParts[i].assembled) obs |= ObsBit<NP>(i);
 	
     //with p - efficiency, randomize ONE
 	if(Bernoulli(pm_efficiency)){
         //Otherwise randomize one element
-        int r = Random(NumContainers);        
-		obs[r] = !obs[r];
+        int r = Random(Parts<NP>());        
+		obs ^= ObsBit<NP>(r);
 	}
 
 	return efficiency;
@@ -879,18 +1190,18 @@ double HOTEL_ROBOT::InspectContainer(const HOTEL_ROBOT_STATE& state, int contain
 }
 
 //Inspect ALL containers at once and return bin array with status
-double HOTEL_ROBOT::InspectAllContainers(const HOTEL_ROBOT_STATE& state, std::vector<bool>& obs) const{
+template<int NP>
+double HOTEL_ROBOT::InspectAllContainers(const HOTEL_ROBOT_STATE& state, int& obs) const{
     double efficiency = PERCEIVE_ACC;
 
-    //obs.resize(state.containerStatus.size());
-    obs.clear();
-    obs.resize(NumContainers);
-    obs = state.containerStatus;
+    obs = 0;
+    for(int i=0; i < Parts<NP>(); i++)
+        if(state.containerStatus[i]) obs |= ObsBit<NP>(i);
     
     //Modify one value with p(1 - efficiency)
     if(Bernoulli(1 - efficiency)){
-        int r = Random(NumContainers);
-		obs[r] = !obs[r];
+        int r = Random(Parts<NP>());
+		obs ^= ObsBit<NP>(r);
     }
     
     return efficiency;
@@ -910,19 +1221,10 @@ double HOTEL_ROBOT::InspectObject(const HOTEL_ROBOT_STATE& state, int& obs) cons
     //Conflicts for obs = 0 include: no unique parts assembled, mutually exclusive parts assembled
     //STRONG ASSUMPTION: ONLY TWO HOTEL TYPES!!!    
     
-    //Get parts unique to A    
-	bool uniquePartsA = false;
     //Is there at least one unique assembled part from hotel A?
-    for(auto p : uniqueParts[0]){        
-        uniquePartsA |= state.workerState.allParts[p].assembled;        
-    }
-
-    //Get parts unique to B    
-	bool uniquePartsB = false;
+	bool uniquePartsA = (state.workerState.assembled & uniqueMask[0]) != 0;
     //Is there at least one unique assembled part from hotel B?
-    for(auto p : uniqueParts[1]){
-        uniquePartsB |= state.workerState.allParts[p].assembled;        
-    }
+	bool uniquePartsB = (state.workerState.assembled & uniqueMask[1]) != 0;
 
     //CONFLICT:
     if((!uniquePartsA && !uniquePartsB) || (uniquePartsA && uniquePartsB)){
@@ -948,29 +1250,20 @@ double HOTEL_ROBOT::InspectObject(const HOTEL_ROBOT_STATE& state, int& obs) cons
 /* Simply convert bool array into a decimal number
  */
 int HOTEL_ROBOT::getObservationIndex(std::vector<bool>& obs) const{
-    int pos = obs.size() - 1; //starting position to convert values
-    int index = 0; //observation index
-    for(auto b : obs){
-        if(b) index += boolValueTable[pos];
-        pos--;
-    }
+    int index = 0; //observation index, first value is the most significant bit
+    for(auto b : obs)
+        index = (index << 1) | b;
 
-	return index;
+    return index;
 }
 
 /*
  * Reconstruct observation array from index number (i.e. dec to bin)
  * */
 void HOTEL_ROBOT::getObservationFromIndex(int index, std::vector<bool>& obs) const{
-    obs.resize(NumContainers); //also inits to 0/false
-    int pos = NumContainers - 1;
-
-    while(index != 0 && pos >= 0){
-        if(index%2 != 0)
-            obs[pos] = true;
-        pos--;
-        index /= 2;
-    }
+    obs.resize(NumContainers);
+    for(int i=0; i < NumContainers; i++)
+        obs[i] = index & ObsBit<0>(i);
 
 }
 
@@ -1113,4 +1406,33 @@ void HOTEL_ROBOT::DisplayAction(int action, std::ostream& ostr) const
 	else if (action == A_PERCEIVE){
         ostr << "Perceive hotel progress" << endl;
     }
-}
\ No newline at end of file
+}
+
+///// Sized hotel, see HOTEL_ROBOT::Create //////
+
+template<int NParts, int NTypes>
+HOTEL_ROBOT_T<NParts, NTypes>::HOTEL_ROBOT_T(PROBLEM_PARAMS& problem_params, HOTEL_PARAMS& ap)
+    : HOTEL_ROBOT(problem_params, ap)
+{
+    assert(NumContainers == NParts && NumTypes == NTypes);
+}
+
+template<int NParts, int NTypes>
+bool HOTEL_ROBOT_T<NParts, NTypes>::Step(STATE& state, int action,
+                                         int& observation, double& reward) const
+{
+    if(Knowledge.RolloutLevel >= KNOWLEDGE::PGS)
+        return StepPGS<NParts>(state, action, observation, reward);
+    else
+        return StepNormal<NParts>(state, action, observation, reward);
+}
+
+template<int NParts, int NTypes>
+void HOTEL_ROBOT_T<NParts, NTypes>::GeneratePGS(const STATE& state, const HISTORY& history,
+                                                vector<int>& legal, const STATUS& status) const
+{
+    GeneratePGSSized<NParts, NTypes>(state, history, legal, status);
+}
+
+template class HOTEL_ROBOT_T<5, 2>;
+template class HOTEL_ROBOT_T<8, 2>;
@@ -66,7 +66,8 @@ struct HOTEL_ROBOT_PARAMS : PROBLEM_PARAMS{
                     entropy(0.5), PGSAlpha(10){}
 };
 
-//TODO: Add array destructor
+// Fixed layout without heap members (names are kept by the simulator), so
+// Copy is a single block copy
 class HOTEL_ROBOT_STATE : public STATE
 {
 public:
@@ -83,14 +84,18 @@ public:
         double LikelihoodT0;
         double LikelihoodNotT0;
         bool assumedType;
+
+        bool operator==(const PO_OBJ& o) const{
+            return ProbT0 == o.ProbT0 && LikelihoodT0 == o.LikelihoodT0 &&
+                LikelihoodNotT0 == o.LikelihoodNotT0 && assumedType == o.assumedType;
+        }
     };
-    vector<PO_OBJ> po_objects;
+    UTILS::FIXED_VECTOR<PO_OBJ, HOTEL_MAX_OBJECTS> po_objects;
     
     //PO container/part properties
     struct ELEMENT{
         //FO
         int id;
-        string name = "";
         int capacity; //Not used
         double cost;
         int priority;
@@ -109,26 +114,22 @@ public:
         double LikelihoodAssembled;
         double LikelihoodNotAssembled;
         double ProbAssembled;
-        
-        //IRE
-        bool active = true;
+
+        bool operator==(const ELEMENT& e) const{
+            return id == e.id && capacity == e.capacity && cost == e.cost && priority == e.priority &&
+                measured == e.measured && count == e.count &&
+                needed == e.needed && low == e.low && empty == e.empty &&
+                LikelihoodEmpty == e.LikelihoodEmpty && LikelihoodNotEmpty == e.LikelihoodNotEmpty &&
+                ProbEmpty == e.ProbEmpty && LikelihoodAssembled == e.LikelihoodAssembled &&
+                LikelihoodNotAssembled == e.LikelihoodNotAssembled && ProbAssembled == e.ProbAssembled;
+        }
     };
-    vector<ELEMENT> containers; //List of storage containers with parts
-    vector<int> storage; //True amount of objs. in containers
-    vector<bool> containerStatus; //True status of storage containers
-    vector<double> p_empty;
+    UTILS::FIXED_VECTOR<ELEMENT, HOTEL_MAX_PARTS> containers; //List of storage containers with parts
+    UTILS::FIXED_VECTOR<int, HOTEL_MAX_PARTS> storage; //True amount of objs. in containers
+    HOTEL_STORAGE containerStatus; //True status of storage containers
+    UTILS::FIXED_VECTOR<double, HOTEL_MAX_PARTS> p_empty;
         
     HOTEL_ROBOT_STATE() {}
-    ~HOTEL_ROBOT_STATE() {
-        containers.clear();
-        storage.clear();
-        containerStatus.clear();
-        p_empty.clear();
-        po_objects.clear();
-    }
-
-    //For F-table
-    void activateFeature(int feature, bool status);
 };
 
 class HOTEL_ROBOT : public SIMULATOR{
@@ -136,6 +137,8 @@ class HOTEL_ROBOT : public SIMULATOR{
 public:
 
     HOTEL_ROBOT(PROBLEM_PARAMS& problem_params, HOTEL_PARAMS& ap);    
+    //Sized HOTEL_ROBOT_T when one is compiled for ap's part and type counts, generic otherwise
+    static HOTEL_ROBOT* Create(PROBLEM_PARAMS& problem_params, HOTEL_PARAMS& ap);
 
     //Core Simulator functions
     virtual STATE* Copy(const STATE& state) const;
@@ -146,21 +149,29 @@ public:
                       int& observation, double& reward) const;
 
     /*** PGS functions ***/
+    //Hot paths take the part (NP) and type (NT) counts as template arguments,
+    //0 reads NumContainers/NumTypes at runtime (see HOTEL_ROBOT_T)
+
     //Uses regular POMCP Step
+    template<int NP = 0>
     bool StepNormal(STATE& state, int action,
                     int& observation, double& reward) const;
     //Step with PGS rewards
+    template<int NP = 0>
     bool StepPGS(STATE& state, int action,
                  int& observation, double& reward) const;
     // Simple Step (transition only)
     bool SimpleStep(STATE& state, int action) const;
     //PGS Rollout policy
-    void GeneratePGS(const STATE& state, const HISTORY& history,
+    virtual void GeneratePGS(const STATE& state, const HISTORY& history,
                      std::vector<int>& legal, const STATUS& status) const;
 
     //Compute PGS value
+    template<int NP = 0>
     double PGS(STATE& state) const;
+    template<int NP = 0>
     double PGS_RO(STATE& oldstate, STATE& state, int action, double oldpgs) const;  //PGS for rollouts
+    virtual bool PGSDeltas(const STATE& state, const std::vector<int>& actions, double* deltas) const;
 
     ///// Incremental refinement /////
     //std::vector<FTABLE::F_ENTRY>& getInitialFTable() const {}
@@ -171,12 +182,21 @@ public:
     /* Virtual functions from Simulator class */
     void GenerateLegal(const STATE& state, const HISTORY& history,
                        std::vector<int>& legal, const STATUS& status) const;
+    template<int NP = 0, int NT = 0>
     void PGSLegal(const STATE& state, const HISTORY& history,
                   std::vector<int>& legal, const STATUS& status) const;
     void GeneratePreferred(const STATE& state, const HISTORY& history,
                            std::vector<int>& legal, const STATUS& status) const;
     virtual bool LocalMove(STATE& state, const HISTORY& history,
                            int stepObservation, const STATUS& status) const;
+    virtual double ObservationLikelihood(STATE& state, const HISTORY& history,
+                                         int stepObservation, const STATUS& status) const;
+    virtual std::size_t Hash(const STATE& state) const;
+    virtual bool Equal(const STATE& state1, const STATE& state2) const;
+    virtual std::size_t Discretise(const STATE& state) const;
+    virtual bool Pack(const STATE& state, UTILS::BIT_WRITER& bits, std::vector<double>& probs) const;
+    virtual void Unpack(UTILS::BIT_READER& bits, const double* probs, STATE& state) const;
+    virtual bool SampleFactors(STATE& state) const;
 
     virtual void DisplayBeliefs(const BELIEF_STATE& beliefState,
                                 std::ostream& ostr) const;
@@ -193,11 +213,34 @@ protected:
     void Init_Demo1();
     
     bool BinEntropyCheck(double p) const; //Verify that p satisfies threshold
+
+    template<int NP> int Parts() const { return NP > 0 ? NP : NumContainers; }
+    template<int NT> int Types() const { return NT > 0 ? NT : NumTypes; }
+    //Observation bit of part i, part 0 is the most significant (see getObservationIndex)
+    template<int NP> int ObsBit(int i) const { return 1 << (Parts<NP>() - 1 - i); }
+
+    //Terms PGS_RO takes from the state before a step, so StepPGS needs no copy of it
+    struct PGS_BEFORE{
+        double points; //Old points that only depend on the old state
+        int hotel; //Current hotel
+        bool hotelUncertain; //and whether its type was uncertain
+    };
+    template<int NP>
+    void PGSBefore(const HOTEL_ROBOT_STATE& oldRState, int action, PGS_BEFORE& before) const;
+    template<int NP>
+    double PGSAfter(const HOTEL_ROBOT_STATE& rState, int action, const PGS_BEFORE& before, double oldpgs) const;
+
+    template<int NP>
+    void PGSDeltasSized(const HOTEL_ROBOT_STATE& rState, const std::vector<int>& actions, double* deltas) const;
+    template<int NP, int NT>
+    void GeneratePGSSized(const STATE& state, const HISTORY& history,
+                          std::vector<int>& legal, const STATUS& status) const;
     
     /* Domain functions */
     bool AssumeStatus(double p) const; //Use current prob. estimation to make rough sim. assumption
-    //Get worker activity/progress. For Insect Hotel it means list of parts
-    double Perceive(const HOTEL_ROBOT_STATE& state, std::vector<bool>& obs) const;
+    //Get worker activity/progress. For Insect Hotel it means list of parts, as observation bits
+    template<int NP = 0>
+    double Perceive(const HOTEL_ROBOT_STATE& state, int& obs) const;
     //Convert obs array into int
     int getObservationIndex(std::vector<bool>& obs) const;
     //Convert observation int to array
@@ -206,7 +249,8 @@ protected:
     //Get container status (empty, not empty)
     double InspectContainer(const HOTEL_ROBOT_STATE& state, int container, int& obs) const;
     //Alternative function: inspect ALL containers at once, similar to perceive worker
-    double InspectAllContainers(const HOTEL_ROBOT_STATE& state, std::vector<bool>& obs) const;
+    template<int NP = 0>
+    double InspectAllContainers(const HOTEL_ROBOT_STATE& state, int& obs) const;
     //Get hotel type (A or B)
     double InspectObject(const HOTEL_ROBOT_STATE& state, int& obs) const;
     
@@ -227,7 +271,7 @@ protected:
     //TODO: switch to std::set
     vector<int> generalParts; //Only the parts that belong to all hotels
     vector<vector<int>> uniqueParts; //For each hotel type, list their unique parts
-    bool contains(vector<int> v, int element) const; //Find if element is part of one of these lists
+    int uniqueMask[2]; //Same as uniqueParts[0] and [1], bit p set for part p
     	
 	/*
 	 * Receive current state and simulate worker action and effects
@@ -235,7 +279,7 @@ protected:
 	 * 
 	 * Here we can use e.g. the Markov chain
 	*/
-	bool simulateWorker(HOTEL_STATE& state, vector<bool>& storage, double& workerReward) const;
+	bool simulateWorker(HOTEL_STATE& state, HOTEL_STORAGE& storage, double& workerReward) const;
         
     double PERCEIVE_ACC; //0 - 1 accuracy for perceive table
     double P_BRING_SUCCESS ;//Simulate grasping or manipulation errors
@@ -267,7 +311,25 @@ protected:
 private:
     friend class RRLIB_HOTEL;
     mutable MEMORY_POOL<HOTEL_ROBOT_STATE> MemoryPool;
-    int boolValueTable[10] = {1,2,4,8,16,32,64,128,256,512};
+};
+
+/*
+ * Hotel with the part and type counts fixed at compile time, for the common
+ * production setups (instantiated in hotel_robot.cpp, picked by
+ * HOTEL_ROBOT::Create). Part loops get constant bounds the compiler can
+ * unroll; states are the same as for the generic HOTEL_ROBOT
+ */
+template<int NParts, int NTypes>
+class HOTEL_ROBOT_T : public HOTEL_ROBOT{
+
+public:
+
+    HOTEL_ROBOT_T(PROBLEM_PARAMS& problem_params, HOTEL_PARAMS& ap);
+
+    virtual bool Step(STATE& state, int action,
+                      int& observation, double& reward) const;
+    virtual void GeneratePGS(const STATE& state, const HISTORY& history,
+                             std::vector<int>& legal, const STATUS& status) const;
 };
 
 #endif
@@ -20,6 +20,7 @@ void HOTEL_WORKER::setProblem(HOTEL_PARAMS& params){
 	N_TYPES = 2; //We will always use 2 types of hotels
 	N_PARTS = params.n_parts;
 	expertise = params.expertise;
+	assert(N_PARTS <= HOTEL_MAX_PARTS && N_OBJECTS <= HOTEL_MAX_OBJECTS);
 	
 	this->objects_str = params.objects_str;
     this->types = params.types;
@@ -27,7 +28,12 @@ void HOTEL_WORKER::setProblem(HOTEL_PARAMS& params){
 	this->part_priority = params.part_priority;	
 	this->type_map = params.type_map;
 
-	for(int i=0; i<N_PARTS; i++) allPartNumbers.push_back(i);
+	assert(type_map.size() == N_TYPES);
+	for(int t=0; t < N_TYPES; t++){
+		typeMask[t] = 0;
+		for(int p : type_map[t])
+			typeMask[t] |= 1 << p;
+	}
 
 	//Initialize pose/object markers
 	P_NONE = 0;
@@ -54,11 +60,11 @@ HOTEL_STATE* HOTEL_WORKER::createStartState() const{
 	s->result = O_OK;	
 	
 	s->hotel = 0; //Initial hotel is always 0
+	s->assembled = 0;
 
 	//Iterate over each object part
 	for(int i=0; i < N_PARTS; i++){
 		H_PART p;
-		p.name = parts_str[i];
 		p.number = i;
 		p.priority = part_priority[i];
 		p.assembled = false;
@@ -71,7 +77,6 @@ HOTEL_STATE* HOTEL_WORKER::createStartState() const{
 	for(int i=0; i<N_OBJECTS; i++){
 		HOTEL o;
 		
-		o.name = objects_str[i];
 		o.type = Random(N_TYPES); //Type is random/unknown
 		o.complete = false; //default value already
 		
@@ -84,7 +89,7 @@ HOTEL_STATE* HOTEL_WORKER::createStartState() const{
 }
 
 double HOTEL_WORKER::Bernoulli(double p) const{    
-    return rand() < p * RAND_MAX;
+    return UTILS::Rand() < p * RAND_MAX;
 }
 
 //Step function takes a previous state and changes variables (action, object) to a new state
@@ -94,7 +99,7 @@ bool HOTEL_WORKER::Step(HOTEL_STATE& state) const{
 	//See if terminal conditions are met
 
 	//If all hotels are complete
-	for(auto h : state.hotels){
+	for(const auto& h : state.hotels){
 		//If ALL are complete, problem is solved
 		terminal &= (h.complete);
 	}
@@ -110,20 +115,12 @@ bool HOTEL_WORKER::Step(HOTEL_STATE& state) const{
 
 	//Check if current hotel is fully assembled
 	int hotelType = state.hotels[state.hotel].type;
-	bool fullyAssembled = true;
-	vector<int> hotelPartList = type_map[hotelType];		
 	//Are all parts of THIS hotel assembled?
-	for(auto p : hotelPartList) fullyAssembled &= state.allParts[p].assembled;
-
-	//Check for parts NOT in this hotel -- Set diff. between hotel and ALL parts
-	bool wrongParts = false;			
-	vector<int> diff;
-	diff.clear();
-	std::set_difference(allPartNumbers.begin(), allPartNumbers.end(), hotelPartList.begin(), hotelPartList.end(), std::inserter(diff, diff.begin()));
-	for(auto p : diff){
-		//cout << "Diff part: " << p << ", assembled? " << state.allParts[p].assembled << endl;
-		wrongParts |= state.allParts[p].assembled;
-	}
+	bool fullyAssembled = (state.assembled & typeMask[hotelType]) == typeMask[hotelType];
+
+	//Check for parts NOT in this hotel
+	int wrongMask = state.assembled & ~typeMask[hotelType];
+	bool wrongParts = wrongMask != 0;
 	//cout << "FullyAssembled is: " << fullyAssembled << endl;
 
 	//If all the right parts and *no wrong parts* are already assembled, hotel is complete
@@ -145,14 +142,11 @@ bool HOTEL_WORKER::Step(HOTEL_STATE& state) const{
 
 			//With p(expertise), worker removes a wrong part
 			if(Bernoulli(expertise)){
-				//Remove one ASSEMBLED part from diff set
-				for(auto dP : diff){
-					if(state.allParts[dP].assembled){
-						state.action = A_REMOVE;
-						state.object = P_PART + state.allParts[dP].number;
-						return false;
-					}
-				}
+				//Remove the lowest numbered wrong part
+				int dP = __builtin_ctz(wrongMask);
+				state.action = A_REMOVE;
+				state.object = P_PART + state.allParts[dP].number;
+				return false;
 			}
 		}
 
@@ -176,7 +170,7 @@ bool HOTEL_WORKER::Step(HOTEL_STATE& state) const{
 			int randNo = Random(numHotelParts);
 			int rand_part = type_map[hotelType][randNo];
 			
-			if(!state.allParts[rand_part].assembled){
+			if(!(state.assembled & (1 << rand_part))){
 				partFound = true;
 				state.action = A_ASSEMBLE;
 				state.object = P_PART + state.allParts[rand_part].number; //Use the PART number, not its position within the array
@@ -228,7 +222,7 @@ bool HOTEL_WORKER::Step(HOTEL_STATE& state) const{
 }
 
 //Take the current state and storage status and generate the result and reward
-void HOTEL_WORKER::generateOutcomes(HOTEL_STATE& state, vector<bool>& storage, double& reward) const
+void HOTEL_WORKER::generateOutcomes(HOTEL_STATE& state, HOTEL_STORAGE& storage, double& reward) const
 {
 	
 	int reward_part_missing = -2;
@@ -256,7 +250,7 @@ void HOTEL_WORKER::generateOutcomes(HOTEL_STATE& state, vector<bool>& storage, d
 			storage[part] = false; //TODO: Empty container with e.g., p = 0.5
 
 			//Find corresponding part and update
-			state.allParts[part].assembled = true;			
+			state.setAssembled(part, true);
 			
 			state.hotels[state.hotel].percentageComplete += (100.0 / type_map[state.hotels[state.hotel].type].size());
 			state.result = O_OK;
@@ -271,10 +265,10 @@ void HOTEL_WORKER::generateOutcomes(HOTEL_STATE& state, vector<bool>& storage, d
 
 	if(state.action == A_REMOVE){
 		int part = state.object - P_PART;
-		if(state.allParts[part].assembled){
+		if(state.assembled & (1 << part)){
 			storage[part] = true; //Restock container
 
-			state.allParts[part].assembled = false;
+			state.setAssembled(part, false);
 			state.hotels[state.hotel].percentageComplete -= (100.0 / type_map[state.hotels[state.hotel].type].size());
 			state.result = O_OK;
 		}
@@ -350,8 +344,9 @@ void HOTEL_WORKER::DisplayState(const HOTEL_STATE& state, std::ostream& ostr) co
 	
 	for(auto e : state.hotels){
 		ostr << "\t[";
-		ostr << std::left << std::setw(3) << count++ << " | ";
-		if(e.name != "") ostr << std::left << std::setw(12) << e.name << " | ";
+		ostr << std::left << std::setw(3) << count << " | ";
+		if(objects_str.size() == N_OBJECTS) ostr << std::left << std::setw(12) << objects_str[count] << " | ";
+		count++;
 		ostr << std::left << std::setw(4) << (e.type? "B" : "A") << " | ";
 		//ostr << std::left << std::setw(5) << (e.needsGlue? "Y" : "N") << " | ";
 		ostr << std::left << std::setw(10) << (e.complete? "Y" : "N") << " | ";
@@ -65,25 +65,38 @@ struct HOTEL_PARAMS{
 	}
 };
 
-// Each part belongs to one storage element
+// State capacity. Observations hold one bit per part in an int, see HOTEL_ROBOT
+const int HOTEL_MAX_PARTS = 10;
+const int HOTEL_MAX_OBJECTS = 4;
+
+// Each part belongs to one storage element. Names are fixed by the problem
+// and kept by the worker (parts_str, objects_str), so states copy as a block
 struct H_PART{
-	string name = "";
 	int number;
 	int priority;
 	bool assembled = false;
+
+	bool operator==(const H_PART& p) const{
+		return number == p.number && priority == p.priority && assembled == p.assembled;
+	}
 };
 
 struct HOTEL{
-	string name = "";
 	int type;	
 	bool complete = false;
 	double percentageComplete = 0;
+
+	bool operator==(const HOTEL& h) const{
+		return type == h.type && complete == h.complete && percentageComplete == h.percentageComplete;
+	}
 };
 
 class HOTEL_STATE{
 	public:
-		vector<HOTEL> hotels; //List of hotels to assemble
-		vector<H_PART> allParts; //List of all possible parts and their current status (name, priority, assembled?, etc.)
+		UTILS::FIXED_VECTOR<HOTEL, HOTEL_MAX_OBJECTS> hotels; //List of hotels to assemble
+		UTILS::FIXED_VECTOR<H_PART, HOTEL_MAX_PARTS> allParts; //List of all possible parts and their current status (priority, assembled?, etc.)
+
+		int assembled; //Bit p set when allParts[p] is assembled, see setAssembled
 
 		int action, object, result;
 
@@ -92,24 +105,26 @@ class HOTEL_STATE{
 
 		HOTEL_STATE(){}
 		
-		~HOTEL_STATE(){
-			allParts.clear();
-			hotels.clear();
-		}
-		
 		void copy(const HOTEL_STATE& s){
-			action = s.action;
-            object = s.object;
-			result = s.result;
-			
-			hotelStage = s.hotelStage;
-			
-			hotel = s.hotel;						
-			hotels = s.hotels;
-			allParts = s.allParts;
+			*this = s;
+		}
+
+		//Keeps the part list and the assembled mask in sync
+		void setAssembled(int part, bool value){
+			allParts[part].assembled = value;
+			if(value) assembled |= 1 << part;
+			else assembled &= ~(1 << part);
+		}
+
+		bool operator==(const HOTEL_STATE& s) const{
+			return action == s.action && object == s.object && result == s.result &&
+				hotelStage == s.hotelStage && hotel == s.hotel &&
+				hotels == s.hotels && allParts == s.allParts;
 		}
 };
 
+typedef UTILS::FIXED_VECTOR<bool, HOTEL_MAX_PARTS> HOTEL_STORAGE; //Container status, true = not empty
+
 class HOTEL_WORKER{
 
 		private:
@@ -119,7 +134,7 @@ class HOTEL_WORKER{
 			vector<string> objects_str, parts_str;
 			vector<int> part_priority, types;
 			vector<vector<int>> type_map; //Contains the definition of hotel types (i.e. their corresponding parts)
-			vector<int> allPartNumbers; //For vector/set operations
+			int typeMask[2]; //Same as type_map, bit p set for each part p of the type
 			
 			int N_OBJECTS, N_PARTS;
 			int N_TYPES = 2;
@@ -140,7 +155,7 @@ class HOTEL_WORKER{
 			
 			HOTEL_STATE* createStartState() const;
 			bool Step(HOTEL_STATE& state) const;
-			void generateOutcomes(HOTEL_STATE& state, vector<bool>& storage, double& reward) const;
+			void generateOutcomes(HOTEL_STATE& state, HOTEL_STORAGE& storage, double& reward) const;
 			
 			const HOTEL_STATE getCurrentState();
 
@@ -7,12 +7,6 @@
 using namespace std;
 using namespace UTILS;
 
-void INCORAPMWE_STATE::activateFeature(int feature, bool status){
-    if(feature >= 0 && feature < PO_Objects.size())
-        PO_Objects[feature].active = status;
-}
-
-
 /* Build Ftable mapping every action to its affected feature/object */
 /*
     In Mobipick, actions afforded by objects are: pick object, identify object
@@ -152,8 +146,6 @@ STATE* INCORAPMWE::CreateStartState() const
         o.LikelihoodNeeded = 1.0;
         o.LikelihoodNotNeeded = 1.0;            
         
-        o.active = true;
-        
         //Add object
         incorapState->PO_Objects.push_back(o);
     }
@@ -193,18 +185,20 @@ bool INCORAPMWE::StepPGS(STATE& state, int action,
    double scale = 10.0;
     double r = 0.0;
     double r2 = 0.0;
-    STATE* oldstate = Copy(state);
+    INCORAPMWE_STATE& incorapState = safe_cast<INCORAPMWE_STATE&>(state);
+
+    //Old potential and the old value PGS_RO reads, taken before the step instead of copying the state
+    r2 = PGS(state);
+    bool wasPresent = action >= A_BRING && incorapState.PO_Objects[action - A_BRING].present;
 
     bool terminal = StepNormal(state, action, observation, reward);
 
     // Potential-based reward bonus
     //if(!terminal){//Not terminal or out of bounds
-        r2 = PGS(*oldstate);
-        r = PGS_RO(*oldstate, state, action, r2); //PGS(state);
+        r = r2 + BringPoints(incorapState, action, wasPresent); //As PGS_RO
         
         reward += PGSAlpha*r - PGSAlpha*r2;        
     //}
-    FreeState(oldstate);
 
     return terminal;
 }
@@ -426,26 +420,35 @@ bool INCORAPMWE::LocalMove(STATE& state, const HISTORY& history, int stepObs, co
 /* Fast PGS for Rollout policy
  * Simplified PGS point count by using only the specific action changes
  */
-double INCORAPMWE::PGS_RO(STATE& oldstate, STATE& state, int action, double oldpgs) const
+/* PGS points of a bring action: +1 when the object is needed and was not present before */
+double INCORAPMWE::BringPoints(const INCORAPMWE_STATE& incorapState, int action, bool wasPresent) const
 {
     double points = 0.0;
-	double oldpoints = 0.0;
-	
-	//1. Cast to cellarstate
-	INCORAPMWE_STATE& incorapState = safe_cast<INCORAPMWE_STATE&>(state);
-	INCORAPMWE_STATE& oldIncorapState = safe_cast<INCORAPMWE_STATE&>(oldstate);
-	
 	int obj = -1;
     
     //Outcome of 'bring' action is either +1 (needed and not present) or else -1 
 	if(action >= A_BRING){
 		obj = action - A_BRING;
-		if (incorapState.PO_Objects[obj].needed && !oldIncorapState.PO_Objects[obj].present){
+		if (incorapState.PO_Objects[obj].needed && !wasPresent){
                 points += PGS_bring_goal;
 		}
 		else
             points += PGS_bring_notgoal;
 	}
+	return points;
+}
+
+double INCORAPMWE::PGS_RO(STATE& oldstate, STATE& state, int action, double oldpgs) const
+{
+    double points = 0.0;
+	double oldpoints = 0.0;
+	
+	//1. Cast to cellarstate
+	INCORAPMWE_STATE& incorapState = safe_cast<INCORAPMWE_STATE&>(state);
+	INCORAPMWE_STATE& oldIncorapState = safe_cast<INCORAPMWE_STATE&>(oldstate);
+	
+	if(action >= A_BRING)
+		points = BringPoints(incorapState, action, oldIncorapState.PO_Objects[action - A_BRING].present);
 
 	//IF estimating points for reducing uncertainty, add oldpoints and current points. ATM, oldpoints = 0 always.
 
@@ -483,7 +486,7 @@ double INCORAPMWE::PGS(STATE& state) const
 void INCORAPMWE::GeneratePGS(const STATE& state, const HISTORY& history,
                          vector<int>& legal, const STATUS& status) const
 {
-    static vector<int> acts;
+    static thread_local vector<int> acts;
 	acts.clear();
 	STATE * newstate;
 	STATE * oldstate = Copy(state);
@@ -543,7 +546,7 @@ void INCORAPMWE::PGSLegal(const STATE& state, const HISTORY& history,
     
     //Selectively allow bringing objects
     for(int o=0; o < NumObjects; o++){
-        if(incorapState.PO_Objects[o].active)
+        if(IsActive(o))
             legal.push_back(A_BRING + o);
     }
 }
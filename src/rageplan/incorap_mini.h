@@ -88,13 +88,8 @@ public:
         double ProbNeeded;
         double LikelihoodNeeded;
         double LikelihoodNotNeeded;
-        
-        //IRE        
-        bool active = true;        
     };    
     vector<PO_OBJECT> PO_Objects;
-    
-    void activateFeature(int feature, bool status);
 };
 
 class INCORAPMWE : public SIMULATOR{
@@ -126,6 +121,7 @@ public:
     //Compute PGS value
     double PGS(STATE& state) const;
     double PGS_RO(STATE& oldstate, STATE& state, int action, double oldpgs) const;  //PGS for rollouts
+    double BringPoints(const INCORAPMWE_STATE& incorapState, int action, bool wasPresent) const; //PGS points of a bring action
 
     ///// Incremental refinement /////
     std::vector<FTABLE::F_ENTRY>& getInitialFTable() const {}
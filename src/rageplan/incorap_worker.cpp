@@ -1,4 +1,5 @@
 #include "incorap_worker.h"
+#include "utils.h"
 
 /*
 	MWE/default constructor
@@ -65,7 +66,7 @@ WORKER_STATE* INCORAP_WORKER::createStartState(){
 }
 
 double INCORAP_WORKER::Bernoulli(double p) const{    
-    return rand() < p * RAND_MAX;
+    return UTILS::Rand() < p * RAND_MAX;
 }
 
 //Step and outcome functions w/o state
@@ -49,9 +49,24 @@ int main(int argc, char* argv[])
 
     searchParams.Verbose = cl.verbose;
     searchParams.useFtable = cl.fTable;
+    searchParams.NumThreads = cl.threads;
+    searchParams.TreeParallel = cl.treeParallel;
+    searchParams.ReuseTree = cl.reuseTree;
+    searchParams.TimeOut = cl.planningTime;
+    searchParams.WideningConstant = cl.wideningK;
+    searchParams.WideningExponent = cl.wideningAlpha;
+    searchParams.EarlyStopDelta = cl.earlyStop;
+    searchParams.WeightedBeliefs = cl.weightedBeliefs;
+    searchParams.CompactBeliefs = cl.compactBeliefs;
+    searchParams.KLDError = cl.kldError;
+    searchParams.FilterParticles = cl.filterParticles;
+    searchParams.FilterTimeOut = cl.filterTime;
+    searchParams.FactoredParticles = cl.factoredParticles;
+    searchParams.PackBeliefs = cl.packBeliefs;
 
     knowledge.TreeLevel = cl.treeKnowledge;
     knowledge.RolloutLevel = cl.rolloutKnowledge;
+    knowledge.AnalyticPGS = cl.analyticPGS;
     
     if(cl.problem == "none")
     {
@@ -130,8 +145,8 @@ int main(int argc, char* argv[])
         worker_params.HOTEL_AIDEMO(); //Initialize hard-coded problem instead of parsing input for now
         cout << "Insect hotel with " << worker_params.n_objs << " objects and " << worker_params.n_types << " types." << endl;
 
-        real = new HOTEL_ROBOT(problem_params, worker_params);
-        simulator = new HOTEL_ROBOT(problem_params, worker_params);
+        real = HOTEL_ROBOT::Create(problem_params, worker_params);
+        simulator = HOTEL_ROBOT::Create(problem_params, worker_params);
         description = problem_params.description;
     }
 	else{
@@ -161,7 +176,12 @@ int main(int argc, char* argv[])
 
     simulator->SetKnowledge(knowledge);
     EXPERIMENT experiment(*real, *simulator, outputfile, expParams, searchParams);
-    experiment.DiscountedReturn();
+    if (cl.benchmark == 2)
+        experiment.PGSBenchmark(*simulator, knowledge);
+    else if (cl.benchmark)
+        experiment.ParallelBenchmark();
+    else
+        experiment.DiscountedReturn();
 
     delete real;
     delete simulator;
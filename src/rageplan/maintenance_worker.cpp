@@ -87,7 +87,7 @@ MAINTENANCE_STATE* MAINTENANCE_WORKER::createStartState(){
 }
 
 double MAINTENANCE_WORKER::Bernoulli(double p) const{    
-    return rand() < p * RAND_MAX;
+    return UTILS::Rand() < p * RAND_MAX;
 }
 
 //Step and outcome functions w/o state
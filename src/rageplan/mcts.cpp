@@ -3,6 +3,9 @@
 
 #include <algorithm>
 #include <iomanip>
+#include <thread>
+#include <functional>
+#include <unordered_set>
 
 using namespace std;
 using namespace UTILS;
@@ -18,14 +21,43 @@ MCTS::PARAMS::PARAMS()
     MaxAttempts(0),
     ExpandCount(1),
     ExplorationConstant(1),
-    DisableTree(false)
+    DisableTree(false),
+    TimeOut(0),
+    TimeCheckInterval(8),
+    NumThreads(1),
+    TreeParallel(false),
+    VirtualLoss(1),
+    ReuseTree(false),
+    MaxPonderSimulations(0),
+    WideningConstant(0),
+    WideningExponent(0.5),
+    WeightedBeliefs(false),
+    ResampleThreshold(0.5),
+    CompactBeliefs(false),
+    FilterParticles(0),
+    FilterTimeOut(0),
+    FactoredParticles(0),
+    PackBeliefs(false),
+    KLDError(0),
+    KLDQuantile(2.326),
+    MinParticles(16),
+    EarlyStopDelta(0)
 {
 }
 
 MCTS::MCTS(const SIMULATOR& simulator, const PARAMS& params)
 :   Simulator(simulator),
     Params(params),
-    TreeDepth(0)
+    TreeDepth(0),
+    NumSimulationsDone(0),
+    NumSimulationsSaved(0),
+    SimulationsPerSecond(0),
+    Seed(0),
+    Worker(false),
+    SharedTree(false),
+    TreeLock(&TreeMutex),
+    PonderStop(false),
+    NumPonderSimulations(0)
 {
     VNODE::NumChildren = Simulator.GetNumActions();
     QNODE::NumChildren = Simulator.GetNumObservations();
@@ -43,12 +75,31 @@ MCTS::MCTS(const SIMULATOR& simulator, const PARAMS& params)
 			Simulator.DisplayState(*state, cout);
 		}
 
-    for (int i = 0; i < Params.NumStartStates; i++)
+    // Factored beliefs cap the particles, only worth it if the simulator
+    // redraws the rest. Probed once on a copy of the start state
+    if (Params.FactoredParticles > 0)
+    {
+        STATE* probe = Simulator.Copy(*state);
+        if (!Simulator.SampleFactors(*probe))
+        {
+            cout << "\tWarning: simulator has no factored beliefs, factoredParticles ignored." << endl;
+            Params.FactoredParticles = 0;
+        }
+        Simulator.FreeState(probe);
+    }
+
+    int numStartStates = Params.NumStartStates;
+    if (Params.FactoredParticles > 0)
+        numStartStates = std::min(numStartStates, Params.FactoredParticles);
+    for (int i = 0; i < numStartStates; i++)
         Root->Beliefs().AddSample(Simulator.CreateStartState());
+    AdaptParticles(Root->Beliefs());
+    PackParticles(Root->Beliefs());
 		
 	/*** Incremental refinement ***/
 	if(Params.useFtable){
-		Simulator.initializeFTable(ftable);		
+		Simulator.initializeFTable(ftable);
+		Simulator.ActivateAllFeatures();
 		//cout << "F-Table from sim received" << endl;
 		if (Params.Verbose >= 1){
 			//cout << "F-Table received (features = " << ftable.getNumFeatures() << ", actions = " << ftable.getNumActions() << ", entries = " << ftable.getNumEntries() << ")." << endl;
@@ -59,15 +110,49 @@ MCTS::MCTS(const SIMULATOR& simulator, const PARAMS& params)
 	
 }
 
+// Search worker for parallel search, shares simulator, parameters and history with master
+MCTS::MCTS(const MCTS& master, unsigned int seed)
+:   Simulator(master.Simulator),
+    TreeDepth(0),
+    NumSimulationsDone(0),
+    NumSimulationsSaved(0),
+    SimulationsPerSecond(0),
+    Seed(seed),
+    Worker(true),
+    SharedTree(false),
+    TreeLock(master.TreeLock),
+    PonderStop(false),
+    NumPonderSimulations(0),
+    Params(master.Params),
+    Root(0),
+    History(master.History),
+    Status(master.Status),
+    ftable(master.ftable)
+{
+    Params.NumThreads = 1;
+    Params.Verbose = 0;
+    ftable.reset(); //Only collect new values, merged back into master table
+}
+
 MCTS::~MCTS()
 {
-    VNODE::Free(Root, Simulator);
-    VNODE::FreeAll();
+    StopPondering();
+    if (Root)
+        VNODE::Free(Root, Simulator);
+    if (!Worker) //Node pool is shared with master
+        VNODE::FreeAll();
 }
 
 bool MCTS::Update(int action, int observation, double reward)
 {
+    return Update(action, observation, reward, std::vector<double>());
+}
+
+bool MCTS::Update(int action, int observation, double reward, const std::vector<double>& confidence)
+{
+    StopPondering();
     History.Add(action, observation);
+    Status.ObsConfidence = confidence;
     BELIEF_STATE beliefs;
 
     // Find matching vnode from the rest of the tree
@@ -78,7 +163,10 @@ bool MCTS::Update(int action, int observation, double reward)
         if (Params.Verbose >= 2)
             cout << "Matched " << vnode->Beliefs().GetNumSamples() << " states" << endl;        
                 
-        beliefs.Copy(vnode->Beliefs(), Simulator);
+        if (Params.ReuseTree)
+            beliefs.Move(vnode->Beliefs()); //vnode becomes the new root
+        else
+            beliefs.Copy(vnode->Beliefs(), Simulator);
     }
     else
     {
@@ -86,9 +174,41 @@ bool MCTS::Update(int action, int observation, double reward)
             cout << "No matching node found" << endl;
     }
 
+    // Weighted beliefs filter all root particles, the matched ones are only
+    // kept if none of them survive. Noisy observations are always weighted
+    bool weighted = Params.WeightedBeliefs || !confidence.empty();
+    bool healthy = false;
+    if (weighted)
+    {
+        BELIEF_STATE posterior;
+        Reweight(Root->Beliefs(), posterior);
+        if (!posterior.Empty())
+        {
+            beliefs.Free(Simulator);
+            beliefs.Move(posterior);
+            healthy = beliefs.GetEffectiveSampleSize() >= Params.ResampleThreshold * Params.NumStartStates;
+        }
+        else if (Params.Verbose >= 1)
+            cout << "No particles consistent with observation" << endl;
+    }
+
+    // Particle filter update, independent of which observations the search sampled
+    if (Params.FilterParticles > 0 && !healthy)
+    {
+        FilterBeliefs(beliefs);
+        healthy = beliefs.GetNumSamples() >= Params.FilterParticles;
+    }
+
     // Generate transformed states to avoid particle deprivation
-    if (Params.UseTransforms)
+    // (from the old root, so this happens before it is freed)
+    if (Params.UseTransforms && !healthy)
         AddTransforms(Root, beliefs);
+
+    if (weighted)
+        Resample(beliefs);
+    AdaptParticles(beliefs);
+    if (Params.FactoredParticles > 0 && beliefs.GetNumSamples() > Params.FactoredParticles)
+        beliefs.Resample(Params.FactoredParticles, Simulator);
     
     // If we still have no particles, fail
     if (beliefs.Empty() && (!vnode || vnode->Beliefs().Empty()))
@@ -98,13 +218,38 @@ bool MCTS::Update(int action, int observation, double reward)
         Simulator.DisplayBeliefs(beliefs, cout);
 
 	 /* After simulation and execution F-table should be revised:
-			1) All beliefs corrected accordingly
-			2) All tables in beliefs updated
+			1) Feature mask corrected accordingly (shared by all beliefs)
+			2) Actions of inactive features toggled in the F-table
 	 */
 
 	if(Params.useFtable)
-		beliefRevision(beliefs);
+		beliefRevision();
+
+    if (Params.CompactBeliefs)
+    {
+        int removed = beliefs.Compact(Simulator);
+        if (Params.Verbose >= 1)
+            cout << "Compacted beliefs to " << beliefs.GetNumSamples() << " particles ("
+                << removed << " duplicates)" << endl;
+    }
+
+    PackParticles(beliefs);
 	 
+    // Keep the matched subtree and its statistics, free only its siblings.
+    // With ReuseTree depth 2 stores particles too, so its children already
+    // hold beliefs and its simulations count towards the next search
+    if (Params.ReuseTree && vnode)
+    {
+        qnode.SetChild(observation, 0);
+        VNODE::Free(Root, Simulator);
+        vnode->Beliefs().Move(beliefs);
+        Root = vnode;
+        if (Params.Verbose >= 1)
+            cout << "Reusing subtree with " << Root->Value.GetCount() << " simulations and "
+                << Root->Beliefs().GetNumSamples() << " particles" << endl;
+        return true;
+    }
+
     // Find a state to initialise prior (only requires fully observed state)
     const STATE* state = 0;
     
@@ -118,24 +263,95 @@ bool MCTS::Update(int action, int observation, double reward)
     //cout << "Done" << endl;
     //Simulator.DisplayState(*state, cout);
 
-    // Delete old tree and create new root
-    //cout << "Free root" << endl;
-    VNODE::Free(Root, Simulator);
+    // Create new root and delete old tree (state may belong to it)
     //cout << "Expand new root" << endl;
     VNODE* newRoot = ExpandNode(state);
+    //cout << "Free root" << endl;
+    VNODE::Free(Root, Simulator);
     //cout << "Assign beliefs" << endl;
-    newRoot->Beliefs() = beliefs;
+    newRoot->Beliefs().Move(beliefs);
     //cout << "New Root" << endl;
     Root = newRoot;
     return true;
 }
 
+/*
+  Speculative search while action is being executed. A background thread
+  runs simulations that all start with action, so the subtrees below the
+  most likely observations grow in proportion to how likely they are.
+  When the real observation arrives, Update promotes the matching subtree
+  (see ReuseTree) and frees the others. Nothing else may use this MCTS
+  until StopPondering or Update is called.
+*/
+void MCTS::StartPondering(int action)
+{
+    StopPondering();
+    if (!Params.ReuseTree || Params.DisableTree || Root->Beliefs().Empty())
+        return;
+
+    PonderStop = false;
+    NumPonderSimulations = 0;
+    PonderThread = std::thread(&MCTS::Ponder, this, action, Rand());
+}
+
+int MCTS::StopPondering()
+{
+    if (!PonderThread.joinable())
+        return 0;
+
+    PonderStop = true;
+    PonderThread.join();
+
+    if (Params.Verbose >= 1)
+        cout << "Pondered " << NumPonderSimulations << " simulations" << endl;
+    return NumPonderSimulations;
+}
+
+void MCTS::Ponder(int action, unsigned int seed)
+{
+    ThreadRandomSeed(seed);
+    int historyDepth = History.Size();
+    QNODE& qnode = Root->Child(action);
+
+    int n;
+    for (n = 0; !PonderStop && (Params.MaxPonderSimulations <= 0 || n < Params.MaxPonderSimulations); n++)
+    {
+        STATE* state = SampleRoot(Root->Beliefs());
+        Simulator.Validate(*state);
+        Status.Phase = SIMULATOR::STATUS::TREE;
+
+        TreeDepth = 0;
+        PeakTreeDepth = 0;
+        SimulateQ(*state, qnode, action);
+
+        Simulator.FreeState(state);
+        History.Truncate(historyDepth);
+    }
+    NumPonderSimulations = n;
+}
+
 int MCTS::SelectAction()
 {
+    return SelectAction(Params.NumSimulations, Params.TimeOut);
+}
+
+int MCTS::SelectAction(int numSims, double timeOut)
+{
+    StopPondering();
+    if (numSims <= 0)
+        numSims = Params.NumSimulations;
+    if (timeOut <= 0)
+        timeOut = Params.TimeOut;
+
     if (Params.DisableTree)
-        RolloutSearch();
+        RolloutSearch(numSims, timeOut);
     else
-        UCTSearch();
+    {
+        // A reused root already holds part of the budget
+        if (Params.ReuseTree)
+            numSims = std::max(numSims - Root->Value.GetCount(), 0);
+        UCTSearch(numSims, timeOut);
+    }
 
     int action;
     
@@ -152,6 +368,12 @@ int MCTS::SelectAction()
 
 void MCTS::RolloutSearch()
 {
+    RolloutSearch(Params.NumSimulations, Params.TimeOut);
+}
+
+void MCTS::RolloutSearch(int numSims, double timeOut)
+{
+	auto timer_start = std::chrono::steady_clock::now();
 	std::vector<double> totals(Simulator.GetNumActions(), 0.0);
 	int historyDepth = History.Size();
 	std::vector<int> legal;
@@ -161,20 +383,22 @@ void MCTS::RolloutSearch()
 
 	REWARD delayedReward;
 
-	for (int i = 0; i < Params.NumSimulations; i++)
+	int i;
+	for (i = 0; i < numSims && !TimedOut(i, timeOut, timer_start); i++)
 	{
 		int action = legal[i % legal.size()];
-		STATE* state = Root->Beliefs().CreateSample(Simulator);
+		STATE* state = SampleRoot(Root->Beliefs());
 		Simulator.Validate(*state);
 
 		int observation;
 		double immediateReward, totalReward, totalFReward;
 		bool terminal = Simulator.Step(*state, action, observation, immediateReward);
 
-		VNODE*& vnode = Root->Child(action).Child(observation);
-		if (!vnode && !terminal)
+		QNODE& qnode = Root->Child(action);
+		if (!qnode.Child(observation) && !terminal)
 		{
-			vnode = ExpandNode(state);
+			VNODE* vnode = ExpandNode(state);
+			qnode.SetChild(observation, vnode);
 			AddSample(vnode, *state);
 		}
 		History.Add(action, observation);
@@ -192,16 +416,55 @@ void MCTS::RolloutSearch()
 		Simulator.FreeState(state);
 		History.Truncate(historyDepth);
 	}
+	NumSimulationsDone = i;
 }
 
 void MCTS::UCTSearch()
 {
+    UCTSearch(Params.NumSimulations, Params.TimeOut);
+}
+
+void MCTS::UCTSearch(int numSims, double timeOut)
+{
+    auto timer_start = std::chrono::steady_clock::now();
     ClearStatistics();
+
+    if (Params.NumThreads > 1 && Params.TreeParallel)
+        NumSimulationsDone = TreeParallelSearch(numSims, timeOut);
+    else if (Params.NumThreads > 1)
+        NumSimulationsDone = RootParallelSearch(numSims, timeOut);
+    else
+        NumSimulationsDone = RunSimulations(Root->Beliefs(), numSims, timeOut);
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - timer_start;
+    SimulationsPerSecond = elapsed.count() > 0 ? NumSimulationsDone / elapsed.count() : 0;
+    NumSimulationsSaved = 0;
+    if (NumSimulationsDone < numSims && Params.EarlyStopDelta > 0 && Decided(Root))
+        NumSimulationsSaved = numSims - NumSimulationsDone;
+
+    if (Params.Verbose >= 1)
+    {
+        if (NumSimulationsSaved > 0)
+            cout << "Root action decided, " << NumSimulationsSaved << " simulations saved. ";
+        else if (NumSimulationsDone < numSims)
+            cout << "Search deadline reached. ";
+        cout << NumSimulationsDone << " simulations in " << elapsed.count() << " s ("
+            << SimulationsPerSecond << " sims/s, " << Params.NumThreads << " threads)" << endl;
+    }
+
+    DisplayStatistics(cout);
+}
+
+// Run simulations from samples of beliefs into this tree, returns no. of simulations done
+int MCTS::RunSimulations(const BELIEF_STATE& beliefs, int numSims, double timeOut)
+{
+    auto timer_start = std::chrono::steady_clock::now();
     int historyDepth = History.Size();
 
-    for (int n = 0; n < Params.NumSimulations; n++)
+    int n;
+    for (n = 0; n < numSims && !TimedOut(n, timeOut, timer_start) && !EarlyStop(n); n++)
     {        
-        STATE* state = Root->Beliefs().CreateSample(Simulator);
+        STATE* state = SampleRoot(beliefs);
         
         //cout << "Sim " << n << " starting sample: " << endl;
         //Simulator.DisplayState(*state, cout);
@@ -232,7 +495,202 @@ void MCTS::UCTSearch()
         History.Truncate(historyDepth);
     }
 
-    DisplayStatistics(cout);
+    return n;
+}
+
+/*
+  Root parallelisation: each worker thread builds its own tree from samples of
+  the shared root belief. Afterwards all worker trees are merged into this one,
+  summing QNODE/VNODE statistics and moving their beliefs, so the final
+  action selection sees the combined counts. The simulation budget (and the
+  deadline) is shared, so more threads means more simulations per second.
+*/
+int MCTS::RootParallelSearch(int numSims, double timeOut)
+{
+    int numThreads = Params.NumThreads;
+    const BELIEF_STATE& beliefs = Root->Beliefs();
+    std::vector<MCTS*> workers;
+    std::vector<std::thread> threads;
+
+    for (int t = 1; t < numThreads; t++)
+    {
+        MCTS* worker = new MCTS(*this, Rand());
+        worker->Root = worker->ExpandNode(beliefs.GetSample(0));
+        workers.push_back(worker);
+
+        int share = numSims / numThreads + (t < numSims % numThreads ? 1 : 0);
+        threads.push_back(std::thread(&MCTS::SearchWorker, worker, std::cref(beliefs), share, timeOut));
+    }
+
+    int done = RunSimulations(beliefs, numSims / numThreads + (numSims % numThreads ? 1 : 0), timeOut);
+
+    for (int t = 0; t < threads.size(); t++)
+    {
+        threads[t].join();
+        done += workers[t]->NumSimulationsDone;
+        MergeNode(Root, workers[t]->Root);
+        if (Params.useFtable)
+            ftable.merge(workers[t]->ftable);
+        delete workers[t];
+    }
+
+    return done;
+}
+
+/*
+  Tree parallelisation: all threads run simulations through the same tree.
+  Node statistics are updated atomically, virtual loss spreads concurrent
+  simulations over different QNODEs and expansions are published with a
+  lock on the QNODE's children (see ExpandShared).
+*/
+int MCTS::TreeParallelSearch(int numSims, double timeOut)
+{
+    int numThreads = Params.NumThreads;
+    const BELIEF_STATE& beliefs = Root->Beliefs();
+    std::vector<MCTS*> workers;
+    std::vector<std::thread> threads;
+
+    SharedTree = true;
+    for (int t = 1; t < numThreads; t++)
+    {
+        MCTS* worker = new MCTS(*this, Rand());
+        worker->Root = Root;
+        worker->SharedTree = true;
+        workers.push_back(worker);
+
+        int share = numSims / numThreads + (t < numSims % numThreads ? 1 : 0);
+        threads.push_back(std::thread(&MCTS::SearchWorker, worker, std::cref(beliefs), share, timeOut));
+    }
+
+    int done = RunSimulations(beliefs, numSims / numThreads + (numSims % numThreads ? 1 : 0), timeOut);
+
+    for (int t = 0; t < threads.size(); t++)
+    {
+        threads[t].join();
+        done += workers[t]->NumSimulationsDone;
+        if (Params.useFtable)
+            ftable.merge(workers[t]->ftable);
+        workers[t]->Root = 0; //Owned by master
+        delete workers[t];
+    }
+    SharedTree = false;
+
+    return done;
+}
+
+void MCTS::SearchWorker(const BELIEF_STATE& beliefs, int numSims, double timeOut)
+{
+    ThreadRandomSeed(Seed);
+    NumSimulationsDone = RunSimulations(beliefs, numSims, timeOut);
+}
+
+/*
+  Add the statistics and beliefs of another tree into vnode.
+  Subtrees that only exist in the other tree are moved over instead of copied.
+*/
+void MCTS::MergeNode(VNODE* vnode, VNODE* other)
+{
+    vnode->Value.Merge(other->Value);
+    vnode->Beliefs().Move(other->Beliefs());
+
+    for (int action = 0; action < VNODE::NumChildren; action++)
+    {
+        QNODE& qnode = vnode->Child(action);
+        QNODE& otherq = other->Child(action);
+        qnode.Value.Merge(otherq.Value);
+
+        std::vector<QNODE::CHILD>& otherChildren = otherq.Children();
+        for (int i = 0; i < otherChildren.size(); i++)
+        {
+            VNODE* otherChild = otherChildren[i].Node;
+            if (!otherChild)
+                continue;
+
+            int observation = otherChildren[i].Observation;
+            VNODE* child = qnode.Child(observation);
+            if (child)
+                MergeNode(child, otherChild);
+            else
+            {
+                qnode.SetChild(observation, otherChild);
+                otherChildren[i].Node = 0;
+            }
+        }
+    }
+}
+
+/*
+  Deadline check for anytime search. The clock is only read once every
+  TimeCheckInterval simulations, and never before the first batch is done,
+  so there is always a root action estimate to return.
+*/
+bool MCTS::TimedOut(int n, double timeOut,
+    const std::chrono::steady_clock::time_point& start) const
+{
+    if (timeOut <= 0 || n == 0)
+        return false;
+    if (Params.TimeCheckInterval > 1 && n % Params.TimeCheckInterval != 0)
+        return false;
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() >= timeOut;
+}
+
+// Early stopping check, run on the same schedule as the deadline check
+bool MCTS::EarlyStop(int n) const
+{
+    if (Params.EarlyStopDelta <= 0 || n == 0)
+        return false;
+    if (Params.TimeCheckInterval > 1 && n % Params.TimeCheckInterval != 0)
+        return false;
+    return Decided(Root);
+}
+
+/*
+  Stopping rule: the greedy action at vnode is final once its value is
+  separated from every other action by a confidence-bound gap. Each value
+  gets a Hoeffding interval of half-width C*sqrt(log(1/delta)/2n), with the
+  exploration constant C as the return scale. Actions ruled out by the prior
+  are ignored and an unvisited action keeps the search going. With the
+  F-table the choice is made by RelevanceUCB, so the search never stops early.
+*/
+bool MCTS::Decided(const VNODE* vnode) const
+{
+    if (Params.useFtable)
+        return false;
+
+    double width = Params.ExplorationConstant * sqrt(log(1.0 / Params.EarlyStopDelta) / 2.0);
+    int best = -1;
+    double bestq = -Infinity, bound = -Infinity;
+
+    for (int action = 0; action < VNODE::NumChildren; action++)
+    {
+        const VALUE<int>& value = vnode->Child(action).Value;
+        int count = value.GetCount();
+        double q = value.GetValue();
+        if (q <= -Infinity)
+            continue;
+        if (count <= 0)
+            return false;
+        if (q > bestq)
+        {
+            bestq = q;
+            best = action;
+        }
+    }
+    if (best < 0)
+        return false;
+
+    for (int action = 0; action < VNODE::NumChildren; action++)
+    {
+        const VALUE<int>& value = vnode->Child(action).Value;
+        double q = value.GetValue();
+        if (action == best || q <= -Infinity)
+            continue;
+        bound = std::max(bound, q + width / sqrt(value.GetCount()));
+    }
+
+    return bestq - width / sqrt(vnode->Child(best).Value.GetCount()) > bound;
 }
 
 MCTS::REWARD MCTS::SimulateV(STATE &state, VNODE *vnode)
@@ -245,12 +703,22 @@ MCTS::REWARD MCTS::SimulateV(STATE &state, VNODE *vnode)
     if (TreeDepth >= Params.MaxDepth) // search horizon reached
         return reward;
 
-    if (TreeDepth == 1)
+    // A reused root's children need particles too, see Update
+    if (TreeDepth == 1 || (TreeDepth == 2 && Params.ReuseTree))
         AddSample(vnode, state);
 
     QNODE& qnode = vnode->Child(action);
-    reward = SimulateQ(state, qnode, action);
+    if (SharedTree)
+    {
+        double loss = -Simulator.GetRewardRange();
+        qnode.Value.AddVirtualLoss(Params.VirtualLoss, loss);
+        reward = SimulateQ(state, qnode, action);
+        qnode.Value.RemoveVirtualLoss(Params.VirtualLoss, loss);
+        vnode->Value.AtomicAdd(reward.V);
+        return reward;
+    }
 
+    reward = SimulateQ(state, qnode, action);
     vnode->Value.Add(reward.V);
     
     return reward;
@@ -274,9 +742,34 @@ MCTS::REWARD MCTS::SimulateQ(STATE &state, QNODE &qnode, int action)
         Simulator.DisplayState(state, cout);
     }
 
-    VNODE*& vnode = qnode.Child(observation);
+    // Progressive widening: once the node has enough observation children,
+    // continue through an existing one instead of opening a new branch.
+    // Not below the root, whose children hold the beliefs for the next step.
+    bool widen = TreeDepth > 0 && !terminal && Params.WideningConstant > 0;
+
+    VNODE* vnode;
+    if (SharedTree)
+        qnode.Lock();
+    vnode = qnode.Child(observation);
+    if (!vnode && widen && !Widen(qnode))
+    {
+        observation = SelectObservation(qnode);
+        vnode = qnode.Child(observation);
+        History.Back().Observation = observation;
+    }
+    if (SharedTree)
+        qnode.Unlock();
+
     if (!vnode && !terminal && qnode.Value.GetCount() >= Params.ExpandCount)
-        vnode = ExpandNode(&state);
+    {
+        if (SharedTree)
+            vnode = ExpandShared(qnode, observation, &state);
+        else
+        {
+            vnode = ExpandNode(&state);
+            qnode.SetChild(observation, vnode);
+        }
+    }
 
     if (!terminal)
     {
@@ -290,18 +783,21 @@ MCTS::REWARD MCTS::SimulateQ(STATE &state, QNODE &qnode, int action)
 
     reward.V = immediateReward + Simulator.GetDiscount() * delayedReward.V;
     reward.F = immediateReward + Simulator.GetFDiscount() * delayedReward.F;
-    qnode.Value.Add(reward.V);
-	 
-	//Update (f,a) value in f-table using discounted return F
-	if(Params.useFtable && !terminal)
-		ftable.valueUpdate(action, reward.F);
+    if (SharedTree)
+        qnode.Value.AtomicAdd(reward.V);
+    else
+        qnode.Value.Add(reward.V);
+
+    //Update (f,a) value in f-table using discounted return F
+    if(Params.useFtable && !terminal)
+        ftable.valueUpdate(action, reward.F);
 
     return reward;
 }
 
-/*** Activate/deactivate objects in all beliefs ***/
+/*** Activate/deactivate features in the simulator's mask, seen by every particle ***/
 //TODO: Determine activation policy
-void MCTS::beliefRevision(BELIEF_STATE& beliefs){	
+void MCTS::beliefRevision(){	
 	std::vector<double> fvalues;
 	ftable.getAllFValues(fvalues);
 	float FTABLE_INACTIVE = ftable.getACTIVATION_THRESHOLD();
@@ -322,12 +818,12 @@ void MCTS::beliefRevision(BELIEF_STATE& beliefs){
 	for(int i=0; i < fvalues.size(); i++) {
 	    allOff = allOff && (fvalues[i] < FTABLE_INACTIVE);
         if (fvalues[i] < FTABLE_INACTIVE){
-            beliefs.activateFeature(i, false);
+            Simulator.ActivateFeature(i, false);
             ftable.toggleActionsForFeature(i, false);
             if(Params.Verbose >= 1) cout << "Feature " << i << " is now OFF" << endl;
         }
         else{
-            beliefs.activateFeature(i, true);
+            Simulator.ActivateFeature(i, true);
             ftable.toggleActionsForFeature(i, true);
             if(Params.Verbose >= 1) cout << "Feature " << i << " is now ON" << endl;
         }
@@ -336,7 +832,7 @@ void MCTS::beliefRevision(BELIEF_STATE& beliefs){
     ///If all features are off, activate one random feature (to get address estimation errors)
     if(allOff){
         int f = Random(fvalues.size());
-        beliefs.activateFeature(f, true);
+        Simulator.ActivateFeature(f, true);
         ftable.toggleActionsForFeature(f, true);
         if(Params.Verbose >= 1) cout << "Feature " << f << " is back ON" << endl;
     }
@@ -345,6 +841,34 @@ void MCTS::beliefRevision(BELIEF_STATE& beliefs){
 	fvalues.clear();
 }
 
+/*
+  The root belief is only sampled until the next Update, so it can stay
+  packed (see BELIEF_STATE::Pack) while the search runs.
+*/
+void MCTS::PackParticles(BELIEF_STATE& beliefs) const
+{
+    if (!Params.PackBeliefs)
+        return;
+
+    beliefs.Pack(Simulator);
+    if (Params.Verbose >= 1 && beliefs.IsPacked())
+        cout << "Packed " << beliefs.GetNumSamples() << " particles into "
+            << beliefs.GetPackedBytes() / 1024 << " KB" << endl;
+}
+
+/*
+  Root particle for a simulation. With factored beliefs the simulator
+  redraws the variables it tracks as marginals, so the few particles kept
+  only need to cover the others.
+*/
+STATE* MCTS::SampleRoot(const BELIEF_STATE& beliefs) const
+{
+    STATE* state = beliefs.CreateSample(Simulator);
+    if (Params.FactoredParticles > 0)
+        Simulator.SampleFactors(*state);
+    return state;
+}
+
 VNODE* MCTS::ExpandNode(const STATE* state)
 {
     VNODE* vnode = VNODE::Create();
@@ -361,10 +885,71 @@ VNODE* MCTS::ExpandNode(const STATE* state)
     return vnode;
 }
 
+// True if qnode may still open a new observation child (k*N^alpha rule),
+// the first child always opens
+bool MCTS::Widen(const QNODE& qnode) const
+{
+    return qnode.GetNumChildren() == 0
+        || qnode.GetNumChildren() < Params.WideningConstant
+        * pow(qnode.Value.GetCount(), Params.WideningExponent);
+}
+
+// Existing observation child, chosen in proportion to its visits
+int MCTS::SelectObservation(const QNODE& qnode) const
+{
+    const std::vector<QNODE::CHILD>& children = qnode.Children();
+    int total = 0;
+    for (int i = 0; i < children.size(); i++)
+        total += children[i].Node->Value.GetCount() + 1;
+
+    int r = Random(total);
+    for (int i = 0; i < children.size(); i++)
+    {
+        r -= children[i].Node->Value.GetCount() + 1;
+        if (r < 0)
+            return children[i].Observation;
+    }
+    return children.back().Observation;
+}
+
+/*
+  Expansion for tree-parallel search. The new node is only added if no
+  other thread expanded the same child in the meantime, otherwise it is
+  discarded and the winning node is used. The node is built outside the
+  QNODE lock, which only covers the lookup and insertion.
+*/
+VNODE* MCTS::ExpandShared(QNODE& qnode, int observation, const STATE* state)
+{
+    VNODE* vnode = ExpandNode(state);
+
+    qnode.Lock();
+    VNODE* existing = qnode.Child(observation);
+    if (!existing)
+        qnode.SetChild(observation, vnode);
+    qnode.Unlock();
+
+    if (!existing)
+        return vnode;
+
+    VNODE::Free(vnode, Simulator);
+    return existing;
+}
+
 void MCTS::AddSample(VNODE* node, const STATE& state)
 {
+    // Every particle of a node is drawn from the same posterior, so with
+    // factored beliefs the first FactoredParticles are as good as any
+    if (Params.FactoredParticles > 0 && node->Beliefs().GetNumSamples() >= Params.FactoredParticles)
+        return;
+
     STATE* sample = Simulator.Copy(state);
-    node->Beliefs().AddSample(sample);
+    if (SharedTree)
+    {
+        std::lock_guard<std::mutex> lock(*TreeLock);
+        node->Beliefs().AddSample(sample);
+    }
+    else
+        node->Beliefs().AddSample(sample);
     if (Params.Verbose >= 2)
     {
         cout << "Adding sample:" << endl;
@@ -377,12 +962,6 @@ void MCTS::AddSample(VNODE* node, const STATE& state)
 */
 int MCTS::RelevanceUCB(VNODE *vnode, bool ucb) const
 {
-    static vector<int> besta;
-    besta.clear();
-    double bestq = -Infinity;
-    int N = vnode->Value.GetCount();
-    double logN = log(N + 1);
-
     vector<int> actions;
     //Relevance option 1: sample state and obtain active actions in that state
         /*STATE* state = vnode->Beliefs().CreateSample(Simulator);
@@ -408,74 +987,87 @@ int MCTS::RelevanceUCB(VNODE *vnode, bool ucb) const
         //Simulator.DisplayState(*state, cout);
     }
 
-    int action = 0;
-    for (int i = 0; i < actions.size(); i++) {
-        action = actions[i];
-
-        double q;
-        int n;
+    assert(!actions.empty());
+    return SelectUCB(vnode, &actions[0], actions.size(), ucb);
+}
 
-        QNODE& qnode = vnode->Child(action);
-        q = qnode.Value.GetValue();
-        n = qnode.Value.GetCount();
-        
-        if (ucb)
-            q += FastUCB(N, n, logN);
+int MCTS::GreedyUCB(VNODE* vnode, bool ucb) const
+{
+    int action = SelectUCB(vnode, 0, Simulator.GetNumActions(), ucb);
 
-        if (q >= bestq)
+    if (Params.Verbose >= 2 && !ucb)
+    {
+        for (int a = 0; a < Simulator.GetNumActions(); a++)
         {
-            if (q > bestq)
-                besta.clear();
-            bestq = q;
-            besta.push_back(action);
+            cout << "\t";
+            Simulator.DisplayAction(a, cout);
+            cout << "\tValue = " << vnode->Child(a).Value.GetValue() << endl;
         }
     }
 
-    actions.clear();
-    assert(!besta.empty());
-    return besta[Random(besta.size())];
+    return action;
 }
 
-int MCTS::GreedyUCB(VNODE* vnode, bool ucb) const
+/*
+  UCB selection kernel over the candidate actions of vnode (all actions if
+  actions is 0). Counts and totals are gathered into local arrays and
+  scored in one branch-free loop that the compiler vectorises, then the
+  best score is found and ties are broken uniformly at random. Scores are
+  identical to the old per-action GetValue() + UCB table computation.
+  Uses no static state, so parallel searches can call it concurrently.
+*/
+int MCTS::SelectUCB(const VNODE* vnode, const int* actions, int numActions, bool ucb) const
 {
-    static vector<int> besta;
-    besta.clear();
-    double bestq = -Infinity;
-    int N = vnode->Value.GetCount();
-    double logN = log(N + 1);
-
-    for (int action = 0; action < Simulator.GetNumActions(); action++)
+    const int MaxLocal = 64;
+    double localCount[MaxLocal], localTotal[MaxLocal], localScore[MaxLocal];
+    std::vector<double> buffer;
+    double* count = localCount;
+    double* total = localTotal;
+    double* score = localScore;
+    if (numActions > MaxLocal)
     {
+        buffer.resize(3 * numActions);
+        count = &buffer[0];
+        total = count + numActions;
+        score = total + numActions;
+    }
 
-        double q;
-        int n;
-
-        QNODE& qnode = vnode->Child(action);
-        q = qnode.Value.GetValue();
-        n = qnode.Value.GetCount();
+    for (int i = 0; i < numActions; i++)
+    {
+        const VALUE<int>& value = vnode->Child(actions ? actions[i] : i).Value;
+        count[i] = value.GetCount();
+        total[i] = value.GetTotal();
+    }
 
-        if (ucb)
-            q += FastUCB(N, n, logN);
+    double logN = log(vnode->Value.GetCount() + 1);
+    double exploration = ucb ? Params.ExplorationConstant : 0;
+    double unvisited = ucb ? Infinity : 0;
+    for (int i = 0; i < numActions; i++)
+    {
+        double n = count[i] > 0 ? count[i] : 1;
+        double q = total[i] / n + exploration * sqrt(logN / n);
+        score[i] = count[i] > 0 ? q : total[i] + unvisited;
+    }
 
-        if (q >= bestq)
+    double bestq = -Infinity;
+    int ties = 0;
+    for (int i = 0; i < numActions; i++)
+    {
+        if (score[i] > bestq)
         {
-            if (q > bestq)
-                besta.clear();
-            bestq = q;
-            besta.push_back(action);
-        }
-
-        if (Params.Verbose >= 2 && !ucb){
-            cout << "\t";
-            Simulator.DisplayAction(action, cout);
-            cout << "\tValue = " << q << endl;
+            bestq = score[i];
+            ties = 1;
         }
-
-        //cout << "UCB: a = " << action << ", q = " << q << endl;
+        else if (score[i] == bestq)
+            ties++;
     }
+    assert(ties > 0);
 
-    assert(!besta.empty());
-    return besta[Random(besta.size())];
+    int tie = Random(ties);
+    for (int i = 0; i < numActions; i++)
+        if (score[i] == bestq && tie-- == 0)
+            return actions ? actions[i] : i;
+    return -1;
 }
 
 MCTS::REWARD MCTS::Rollout(STATE &state)
@@ -522,12 +1114,110 @@ MCTS::REWARD MCTS::Rollout(STATE &state)
     return rewardSt;
 }
 
+/*
+  Particle filter update: root particles are drawn, stepped with the last
+  action and kept with probability equal to the likelihood of the real
+  observation (see SIMULATOR::ObservationLikelihood), until beliefs hold
+  FilterParticles particles. NumThreads threads draw in batches of
+  TimeCheckInterval and stop on FilterTimeOut, or after MaxAttempts attempts
+  (shared with AddTransforms) if the observation is too unlikely.
+*/
+void MCTS::FilterBeliefs(BELIEF_STATE& beliefs)
+{
+    int target = Params.FilterParticles - beliefs.GetNumSamples();
+    if (target <= 0 || Root->Beliefs().Empty())
+        return;
+
+    int numThreads = std::max(std::min(Params.NumThreads, Params.MaxAttempts), 1);
+    std::atomic<int> attempts(0), added(0);
+    std::vector<std::vector<STATE*> > particles(numThreads);
+    std::vector<std::thread> threads;
+
+    for (int t = 1; t < numThreads; t++)
+        threads.push_back(std::thread(&MCTS::FilterWorker, this,
+            std::ref(attempts), std::ref(added), target, std::ref(particles[t]), Rand() + 1));
+    FilterWorker(attempts, added, target, particles[0], 0);
+
+    for (int t = 0; t < threads.size(); t++)
+        threads[t].join();
+
+    for (int t = 0; t < numThreads; t++)
+        for (int i = 0; i < particles[t].size(); i++)
+            beliefs.AddSample(particles[t][i]);
+
+    if (Params.Verbose >= 1)
+        cout << "Particle filter added " << std::min(added.load(), target) << " particles in "
+            << std::min(attempts.load(), Params.MaxAttempts) << " attempts" << endl;
+}
+
+void MCTS::FilterWorker(std::atomic<int>& attempts, std::atomic<int>& added, int target,
+    std::vector<STATE*>& particles, unsigned int seed) const
+{
+    if (seed)
+        ThreadRandomSeed(seed);
+
+    auto timer_start = std::chrono::steady_clock::now();
+    int action = History.Back().Action;
+
+    for (int n = 0; added < target && !TimedOut(n, Params.FilterTimeOut, timer_start); n++)
+    {
+        if (attempts++ >= Params.MaxAttempts)
+            break;
+
+        int stepObs;
+        double stepReward;
+        STATE* state = SampleRoot(Root->Beliefs());
+        bool terminal = Simulator.Step(*state, action, stepObs, stepReward);
+        double likelihood = terminal ? 0 :
+            Simulator.ObservationLikelihood(*state, History, stepObs, Status);
+
+        if (likelihood > 0 && (likelihood >= 1 || Bernoulli(likelihood)) && added++ < target)
+            particles.push_back(state);
+        else
+            Simulator.FreeState(state);
+    }
+}
+
+/*
+  Particle reinvigoration. Transform attempts are shared out between
+  NumThreads threads, each with its own RNG stream, through one attempt
+  counter, and all threads stop as soon as NumTransforms have been accepted.
+  Accepted transforms are added to beliefs once the threads are done.
+*/
 void MCTS::AddTransforms(VNODE* root, BELIEF_STATE& beliefs)
 {
-    int attempts = 0, added = 0;    
-    
-    // Local transformations of state that are consistent with history
-    while (added < Params.NumTransforms && attempts < Params.MaxAttempts)
+    int numThreads = std::max(std::min(Params.NumThreads, Params.MaxAttempts), 1);
+    std::atomic<int> attempts(0), added(0);
+    std::vector<std::vector<STATE*> > transforms(numThreads);
+    std::vector<std::thread> threads;
+
+    for (int t = 1; t < numThreads; t++)
+        threads.push_back(std::thread(&MCTS::TransformWorker, this,
+            std::ref(attempts), std::ref(added), std::ref(transforms[t]), Rand() + 1));
+    TransformWorker(attempts, added, transforms[0], 0);
+
+    for (int t = 0; t < threads.size(); t++)
+        threads[t].join();
+
+    for (int t = 0; t < numThreads; t++)
+        for (int i = 0; i < transforms[t].size(); i++)
+            beliefs.AddSample(transforms[t][i]);
+
+    if (Params.Verbose >= 2)
+    {
+        cout << "Created " << std::min(added.load(), Params.NumTransforms) << " local transformations out of "
+            << std::min(attempts.load(), Params.MaxAttempts) << " attempts" << endl;
+    }    
+}
+
+// Local transformations of state that are consistent with history (seed 0 keeps the caller's RNG)
+void MCTS::TransformWorker(std::atomic<int>& attempts, std::atomic<int>& added,
+    std::vector<STATE*>& transforms, unsigned int seed) const
+{
+    if (seed)
+        ThreadRandomSeed(seed);
+
+    while (added < Params.NumTransforms && attempts++ < Params.MaxAttempts)
     {
         STATE* transform = CreateTransform();
 
@@ -535,17 +1225,132 @@ void MCTS::AddTransforms(VNODE* root, BELIEF_STATE& beliefs)
         {
             //cout << "Adding transform"<< endl;
             //Simulator.DisplayState(*transform,cout);
-            beliefs.AddSample(transform);            
-            added++;
+            if (added++ < Params.NumTransforms)
+                transforms.push_back(transform);
+            else
+                Simulator.FreeState(transform); //Another thread reached NumTransforms first
+        }
+    }
+}
+
+/*
+  Particle filter step for weighted beliefs: every particle of prior is moved
+  through the last action and weighted by the likelihood of the real
+  observation (see SIMULATOR::ObservationLikelihood). A compacted prior is
+  first resampled to NumStartStates shared particles, so merged duplicates
+  still spread out. Weights are scaled to average 1, so they cannot
+  underflow over an episode.
+*/
+void MCTS::Reweight(const BELIEF_STATE& prior, BELIEF_STATE& beliefs) const
+{
+    int action = History.Back().Action;
+    std::vector<STATE*> states;
+    std::vector<double> weights;
+    double total = 0;
+
+    const BELIEF_STATE* particles = &prior;
+    BELIEF_STATE expanded;
+    if (Params.CompactBeliefs && prior.IsWeighted())
+    {
+        expanded.Copy(prior, Simulator);
+        expanded.Unpack(Simulator);
+        expanded.Resample(Params.NumStartStates, Simulator);
+        particles = &expanded;
+    }
+
+    for (int i = 0; i < particles->GetNumSamples(); i++)
+    {
+        int stepObs;
+        double stepReward;
+        STATE* state = particles->CreateSample(i, Simulator);
+        bool terminal = Simulator.Step(*state, action, stepObs, stepReward);
+        double weight = terminal ? 0 : particles->GetWeight(i) *
+            Simulator.ObservationLikelihood(*state, History, stepObs, Status);
+
+        if (weight > 0)
+        {
+            states.push_back(state);
+            weights.push_back(weight);
+            total += weight;
         }
-        attempts++;
+        else
+            Simulator.FreeState(state);
     }
+    expanded.Free(Simulator);
+
+    for (int i = 0; i < states.size(); i++)
+        beliefs.AddSample(states[i], weights[i] * states.size() / total);
 
     if (Params.Verbose >= 2)
+        cout << states.size() << " of " << particles->GetNumSamples()
+            << " particles consistent with observation" << endl;
+}
+
+/*
+  Systematic resampling of weighted beliefs to NumStartStates particles,
+  once their effective sample size drops below ResampleThreshold of that.
+*/
+void MCTS::Resample(BELIEF_STATE& beliefs)
+{
+    double ess = beliefs.GetEffectiveSampleSize();
+    if (beliefs.Empty() || ess >= Params.ResampleThreshold * Params.NumStartStates)
+        return;
+
+    if (Params.Verbose >= 1)
+        cout << "Resampling " << beliefs.GetNumSamples() << " particles (effective sample size "
+            << ess << ")" << endl;
+    beliefs.Resample(Params.NumStartStates, Simulator);
+}
+
+/*
+  KLD-sampling (Fox, 2003): particles are drawn from beliefs by weight, and
+  shared, until there are as many as the KLD bound for the no. of bins
+  they occupy (see SIMULATOR::Discretise). A nearly certain belief occupies
+  few bins and keeps only a few particles. Beliefs are left alone if the
+  bound reaches their current size.
+*/
+void MCTS::AdaptParticles(BELIEF_STATE& beliefs)
+{
+    int numSamples = beliefs.GetNumSamples();
+    if (Params.KLDError <= 0 || numSamples <= Params.MinParticles)
+        return;
+
+    BELIEF_STATE adapted;
+    std::unordered_set<std::size_t> bins;
+    int bound = Params.MinParticles;
+    while (adapted.GetNumSamples() < bound && adapted.GetNumSamples() < numSamples)
     {
-        cout << "Created " << added << " local transformations out of "
-            << attempts << " attempts" << endl;
-    }    
+        int index = beliefs.SampleIndex();
+        std::size_t bin = Simulator.Discretise(*beliefs.GetSample(index));
+        if (bin == 0)
+            break;
+        adapted.ShareSample(beliefs, index);
+        if (bins.insert(bin).second)
+            bound = KLDBound(bins.size());
+    }
+
+    if (adapted.GetNumSamples() >= bound && adapted.GetNumSamples() < numSamples)
+    {
+        if (Params.Verbose >= 1)
+            cout << "KLD-sampling kept " << adapted.GetNumSamples() << " of " << numSamples
+                << " particles (" << bins.size() << " bins)" << endl;
+        beliefs.Free(Simulator);
+        beliefs.Move(adapted);
+    }
+    else
+        adapted.Free(Simulator);
+}
+
+// Sample size for KL divergence <= KLDError with probability 1-delta over k bins
+int MCTS::KLDBound(int bins) const
+{
+    if (bins <= 1)
+        return Params.MinParticles;
+
+    double a = 2.0 / (9.0 * (bins - 1));
+    double b = 1.0 - a + sqrt(a) * Params.KLDQuantile;
+    double bound = (bins - 1) / (2.0 * Params.KLDError) * b * b * b;
+    return std::max((int) ceil(bound), Params.MinParticles);
 }
 
 STATE* MCTS::CreateTransform() const
@@ -553,7 +1358,7 @@ STATE* MCTS::CreateTransform() const
     int stepObs;
     double stepReward;       
     
-    STATE* state = Root->Beliefs().CreateSample(Simulator);
+    STATE* state = SampleRoot(Root->Beliefs());
     Simulator.Step(*state, History.Back().Action, stepObs, stepReward);
     
     if (Simulator.LocalMove(*state, History, stepObs, Status))
@@ -563,32 +1368,6 @@ STATE* MCTS::CreateTransform() const
     return 0;
 }
 
-double MCTS::UCB[UCB_N][UCB_n];
-bool MCTS::InitialisedFastUCB = true;
-
-void MCTS::InitFastUCB(double exploration)
-{
-    cout << "Initialising fast UCB table... ";
-    for (int N = 0; N < UCB_N; ++N)
-        for (int n = 0; n < UCB_n; ++n)
-            if (n == 0)
-                UCB[N][n] = Infinity;
-            else
-                UCB[N][n] = exploration * sqrt(log(N + 1) / n);
-    cout << "done" << endl;
-    InitialisedFastUCB = true;
-}
-
-inline double MCTS::FastUCB(int N, int n, double logN) const
-{
-    if (InitialisedFastUCB && N < UCB_N && n < UCB_n)
-        return UCB[N][n];
-
-    if (n == 0)
-        return Infinity;
-    else
-        return Params.ExplorationConstant * sqrt(logN / n);
-}
 
 void MCTS::ClearStatistics()
 {
@@ -608,9 +1387,9 @@ void MCTS::DisplayStatistics(ostream& ostr) const
 
     if (Params.Verbose >= 2)
     {
-        ostr << "Policy after " << Params.NumSimulations << " simulations" << endl;
+        ostr << "Policy after " << NumSimulationsDone << " simulations" << endl;
         DisplayPolicy(6, ostr);
-        ostr << "Values after " << Params.NumSimulations << " simulations" << endl;
+        ostr << "Values after " << NumSimulationsDone << " simulations" << endl;
         DisplayValue(6, ostr);
     }
 }
@@ -5,6 +5,10 @@
 #include "node.h"
 #include "statistic.h"
 #include <stack>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <atomic>
 
 class MCTS
 {
@@ -29,6 +33,26 @@ public:
         int ExpandCount;
         double ExplorationConstant;
         bool DisableTree;
+        double TimeOut; //Search deadline in seconds (0 = run all NumSimulations)
+        int TimeCheckInterval; //Simulations between deadline checks
+        int NumThreads; //Parallel search threads (1 = serial)
+        bool TreeParallel; //Threads share one tree instead of merging separate root trees
+        int VirtualLoss; //Virtual visits added to a QNODE while a tree-parallel simulation runs through it
+        bool ReuseTree; //Keep the matched subtree as the new root after Update
+        int MaxPonderSimulations; //Simulations per pondering phase (0 = until stopped)
+        double WideningConstant; //Progressive widening: new observation children only while there are < k*N^alpha (k = 0 disables)
+        double WideningExponent; //alpha
+        bool WeightedBeliefs; //Update the root belief as a particle filter, weighting by observation likelihood
+        double ResampleThreshold; //Resample weighted beliefs when the effective sample size drops below this fraction of NumStartStates
+        bool CompactBeliefs; //Merge duplicate root particles after each update
+        int FilterParticles; //Particle filter update: step root particles until this many fit the real observation (0 = off)
+        double FilterTimeOut; //Time budget in seconds for the particle filter update (0 = none, MaxAttempts still applies)
+        int FactoredParticles; //Factored beliefs: particles kept per node, the simulator draws the rest from marginals (0 = off, approximate, see SIMULATOR::SampleFactors)
+        bool PackBeliefs; //Keep the root belief bit-packed, decoding particles as simulations start
+        double KLDError; //Adaptive particle count: KL divergence bound for KLD-sampling the root belief (0 = always NumStartStates)
+        double KLDQuantile; //Upper 1-delta quantile of the standard normal for the KLD bound
+        int MinParticles; //Fewest root particles kept by KLD-sampling
+        double EarlyStopDelta; //Early stopping: end the search once the greedy root action is separated at confidence 1-delta (0 = off)
 		STATE* startstate = 0; //Added for consistency with randomly generated initial states
 		bool useFtable = false;
     };
@@ -37,29 +61,57 @@ public:
     ~MCTS();
 
     int SelectAction();
+    //Anytime search: stop after numSims simulations or timeOut seconds, whichever comes first (<= 0 uses PARAMS)
+    int SelectAction(int numSims, double timeOut);
     bool Update(int action, int observation, double reward);
+    //Noisy observation: particles are weighted by the confidence of each observation bit (see STATUS)
+    bool Update(int action, int observation, double reward, const std::vector<double>& confidence);
+
+    //Pondering: keep searching below action in the background while it is executed.
+    //Stopped by StopPondering or Update, which then adopts the observed subtree.
+    void StartPondering(int action);
+    int StopPondering(); //Returns no. of simulations done while pondering
+    bool IsPondering() const { return PonderThread.joinable(); }
 
     void UCTSearch();
+    void UCTSearch(int numSims, double timeOut);
     void RolloutSearch();
+    void RolloutSearch(int numSims, double timeOut);
 
     REWARD Rollout(STATE &state);
 
     const BELIEF_STATE& BeliefState() const { return Root->Beliefs(); }
     const HISTORY& GetHistory() const { return History; }
     const SIMULATOR::STATUS& GetStatus() const { return Status; }
+    double GetActionValue(int action) const { return Root->Child(action).Value.GetValue(); }
+    int GetNumSimulations() const { return NumSimulationsDone; } //Simulations completed in the last search
+    double GetSimulationsPerSecond() const { return SimulationsPerSecond; } //Throughput of the last search
+    int GetSimulationsSaved() const { return NumSimulationsSaved; } //Budget left when the last search stopped early
     void ClearStatistics();
     void DisplayStatistics(std::ostream& ostr) const;
     void DisplayValue(int depth, std::ostream& ostr) const;
     void DisplayPolicy(int depth, std::ostream& ostr) const;
 
     static void UnitTest();
-    static void InitFastUCB(double exploration);
 	 
 	void getFValues(std::vector<double> fvalues);
 
 private:
+    MCTS(const MCTS& master, unsigned int seed); //Parallel search worker
+
     const SIMULATOR& Simulator;
     int TreeDepth, PeakTreeDepth;
+    int NumSimulationsDone;
+    int NumSimulationsSaved;
+    double SimulationsPerSecond;
+    unsigned int Seed; //Worker RNG seed
+    bool Worker;
+    bool SharedTree; //Running tree-parallel, use atomic updates
+    std::mutex TreeMutex;
+    std::mutex* TreeLock; //Master's TreeMutex, guards beliefs in a shared tree
+    std::thread PonderThread;
+    std::atomic<bool> PonderStop;
+    int NumPonderSimulations;
     PARAMS Params;
     VNODE* Root;
     HISTORY History;
@@ -70,26 +122,46 @@ private:
     STATISTIC StatTotalReward;
 
 	FTABLE ftable; /*** F-table for incremental refinement ***/
-	void beliefRevision(BELIEF_STATE& beliefs); /*** Activate/deactivate objects in all beliefs ***/
+	void beliefRevision(); /*** Activate/deactivate features for the search ***/
 	int RelevanceUCB(VNODE *vnode, bool ucb) const; /*** F-aware UCB action selection ***/
 
+    // Parallel search
+    int RunSimulations(const BELIEF_STATE& beliefs, int numSims, double timeOut);
+    int RootParallelSearch(int numSims, double timeOut);
+    int TreeParallelSearch(int numSims, double timeOut);
+    VNODE* ExpandShared(QNODE& qnode, int observation, const STATE* state);
+    bool Widen(const QNODE& qnode) const;
+    int SelectObservation(const QNODE& qnode) const;
+    void SearchWorker(const BELIEF_STATE& beliefs, int numSims, double timeOut);
+    void MergeNode(VNODE* vnode, VNODE* other);
+    void Ponder(int action, unsigned int seed);
+
     // Core MCTS Functions
     int GreedyUCB(VNODE* vnode, bool ucb) const;
+    int SelectUCB(const VNODE* vnode, const int* actions, int numActions, bool ucb) const;
     int SelectRandom() const;
     REWARD SimulateV(STATE &state, VNODE *vnode);
     REWARD SimulateQ(STATE &state, QNODE &qnode, int action);
     VNODE* ExpandNode(const STATE* state);
+    STATE* SampleRoot(const BELIEF_STATE& beliefs) const;
     void AddSample(VNODE* node, const STATE& state);
     void AddTransforms(VNODE* root, BELIEF_STATE& beliefs);
+    void TransformWorker(std::atomic<int>& attempts, std::atomic<int>& added,
+        std::vector<STATE*>& transforms, unsigned int seed) const;
+    void FilterBeliefs(BELIEF_STATE& beliefs);
+    void FilterWorker(std::atomic<int>& attempts, std::atomic<int>& added, int target,
+        std::vector<STATE*>& particles, unsigned int seed) const;
     STATE* CreateTransform() const;
     void Resample(BELIEF_STATE& beliefs);
-
-    // Fast lookup table for UCB
-    static const int UCB_N = 10000, UCB_n = 100;
-    static double UCB[UCB_N][UCB_n];
-    static bool InitialisedFastUCB;
-
-    double FastUCB(int N, int n, double logN) const;
+    void Reweight(const BELIEF_STATE& prior, BELIEF_STATE& beliefs) const;
+    void AdaptParticles(BELIEF_STATE& beliefs);
+    void PackParticles(BELIEF_STATE& beliefs) const;
+    int KLDBound(int bins) const;
+
+    bool TimedOut(int n, double timeOut,
+        const std::chrono::steady_clock::time_point& start) const;
+    bool EarlyStop(int n) const;
+    bool Decided(const VNODE* vnode) const;
 
     static void UnitTestGreedy();
     static void UnitTestUCB();
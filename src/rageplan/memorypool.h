@@ -3,6 +3,7 @@
 
 #include <vector>
 #include <ostream>
+#include <mutex>
 
 class MEMORY_OBJECT
 {
@@ -44,8 +45,10 @@ public:
         Free(obj);
     }
 
+    // Allocate and Free are serialised so pools can be shared by parallel searches
     T* Allocate() 
     { 
+        std::lock_guard<std::mutex> lock(Mutex);
         if (FreeList.empty())
             NewChunk();
         T* obj = FreeList.back();
@@ -58,6 +61,7 @@ public:
     
     void Free(T* obj) 
     { 
+        std::lock_guard<std::mutex> lock(Mutex);
         assert(obj->IsAllocated());
         obj->ClearAllocated();
         FreeList.push_back(obj);
@@ -66,6 +70,7 @@ public:
     
     void DeleteAll()
     {
+        std::lock_guard<std::mutex> lock(Mutex);
         for (ChunkIterator i_chunk = Chunks.begin(); i_chunk != Chunks.end(); ++i_chunk)
             delete *i_chunk;
         Chunks.clear();
@@ -97,6 +102,7 @@ private:
     std::vector<CHUNK*> Chunks;
     std::vector<T*> FreeList;
     int NumAllocated;
+    std::mutex Mutex;
     typedef typename std::vector<CHUNK*>::iterator ChunkIterator;
 };
 
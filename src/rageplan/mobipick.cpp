@@ -7,23 +7,6 @@
 using namespace std;
 using namespace UTILS;
 
-void MOBIPICK_STATE::activateFeature(int feature, bool status){
-    // Find object id within Tables
-    bool done = false;
-    if(feature >= 0){
-        for(auto& t : Tables){
-            for(auto& o : t.Objects){
-                if(o.id == feature){
-                    o.active = status;
-                    done = true;
-                }
-                if(done) break;
-            }
-            if(done) break;
-        }
-    }
-}
-
 MOBIPICK_STATE::~MOBIPICK_STATE(){
     for(auto& t : Tables){
         t.Objects.clear();
@@ -218,8 +201,6 @@ STATE* MOBIPICK::CreateStartState() const
             o.LikelihoodPos = 1.0;
             o.LikelihoodNotPos = 1.0;
             
-            o.active = true;
-            
             //Add to object array
             t.Objects.push_back(o);
         }
@@ -270,18 +251,26 @@ bool MOBIPICK::StepPGS(STATE& state, int action,
     double scale = 10.0;
     double r = 0.0;
     double r2 = 0.0;
-    STATE* oldstate = Copy(state);
+    MOBIPICK_STATE& mobipickState = safe_cast<MOBIPICK_STATE&>(state);
+
+    //Old potential and the old values PGS_RO reads, taken before the step instead of copying the state
+    r2 = PGS(state);
+    bool placing = action >= A_PLACE && action < A_PERCEIVE;
+    bool wasGrasping = mobipickState.grasping;
+    int graspedType = mobipickState.inGrasp.type;
+    double oldpoints = 0.0;
+    if(action >= A_IDENTIFY && !placing)
+        oldpoints = ActionPoints(mobipickState, action);
 
     bool terminal = StepNormal(state, action, observation, reward);
 
     // Potential-based reward bonus
     //if(!terminal){//Not terminal or out of bounds
-        r2 = PGS(*oldstate);
-        r = PGS_RO(*oldstate, state, action, r2); //PGS(state);
+        double points = placing ? PlacePoints(mobipickState, wasGrasping, graspedType) : ActionPoints(mobipickState, action);
+        r = r2 - oldpoints + points; //As PGS_RO
         
         reward += PGSAlpha*r - PGSAlpha*r2;        
     //}
-    FreeState(oldstate);
 
     return terminal;
 }
@@ -673,29 +662,19 @@ bool MOBIPICK::LocalMove(STATE& state, const HISTORY& history, int stepObs, cons
 /* Fast PGS for Rollout policy
  * Simplified PGS point count by using only the specific action changes
  */
-double MOBIPICK::PGS_RO(STATE& oldstate, STATE& state, int action, double oldpgs) const
+/* PGS points of the object picked or identified, or of the table perceived by action,
+ * within one state (placing scores across two states, see PlacePoints)
+ */
+double MOBIPICK::ActionPoints(const MOBIPICK_STATE& mobipickState, int action) const
 {
     double points = 0.0;
-    double oldpoints = 0.0;
 
-    //1. Cast to cellarstate
-    MOBIPICK_STATE& mobipickState = safe_cast<MOBIPICK_STATE&>(state);
-    MOBIPICK_STATE& oldmobipickState = safe_cast<MOBIPICK_STATE&>(oldstate);
-        
     //1. Grasp: + if obj was in fact picked, and is cyl and has known pos
     if(action >= A_PICK && action < A_IDENTIFY && mobipickState.grasping){
         //If object grasped is likely a cyl AND has known position, give bonus
         if( BinEntropyCheck(mobipickState.inGrasp.ProbCyl) && mobipickState.inGrasp.PosKnown ) points += PGS_pick_pos;
     }
     
-    //2. Place in Basket (if place and object held WAS good/bad...reward)
-    else if(action >= A_PLACE && action < A_PERCEIVE){
-        if(mobipickState.AgentPose == P_BASKET && oldmobipickState.grasping){
-            if(oldmobipickState.inGrasp.type == F_CYL) points += PGS_good_obj;
-            else points += PGS_bad_obj;
-        }
-    }
-    
     //3. Identify: neg. points if object fails binEntropyCheck
     else if (action >= A_IDENTIFY && action < A_PLACE){
         int obj = action - A_IDENTIFY;
@@ -704,10 +683,10 @@ double MOBIPICK::PGS_RO(STATE& oldstate, STATE& state, int action, double oldpgs
         int table_id, o_pos;        
         bool found = false;
         
-        for(auto t : mobipickState.Tables){
+        for(const auto& t : mobipickState.Tables){
             table_id = t.id;
             o_pos = 0;            
-            for(auto o : t.Objects){
+            for(const auto& o : t.Objects){
                 if(o.id == obj) found = true;
                 if(found) break;
                 o_pos++;
@@ -717,7 +696,6 @@ double MOBIPICK::PGS_RO(STATE& oldstate, STATE& state, int action, double oldpgs
         
         if(found){        
             if(!BinEntropyCheck(mobipickState.Tables[table_id].Objects[o_pos].ProbCyl)) points += PGS_uncertain;                        
-            if(!BinEntropyCheck(oldmobipickState.Tables[table_id].Objects[o_pos].ProbCyl)) oldpoints += PGS_uncertain;            
         }
     }
     
@@ -731,10 +709,41 @@ double MOBIPICK::PGS_RO(STATE& oldstate, STATE& state, int action, double oldpgs
         if(table_id >= 0 && table_id < NumTables){
             for(int o_pos=0; o_pos < mobipickState.Tables[table_id].Objects.size(); o_pos++){
                 if(!mobipickState.Tables[table_id].Objects[o_pos].PosKnown) points += PGS_uncertain;
-                if(!oldmobipickState.Tables[table_id].Objects[o_pos].PosKnown) oldpoints += PGS_uncertain;
             }
         }
     }
+    return points;
+}
+
+/* PGS points for placing, given what was held before the step */
+double MOBIPICK::PlacePoints(const MOBIPICK_STATE& mobipickState, bool wasGrasping, int graspedType) const
+{
+    double points = 0.0;
+    if(mobipickState.AgentPose == P_BASKET && wasGrasping){
+        if(graspedType == F_CYL) points += PGS_good_obj;
+        else points += PGS_bad_obj;
+    }
+    return points;
+}
+
+double MOBIPICK::PGS_RO(STATE& oldstate, STATE& state, int action, double oldpgs) const
+{
+    double points = 0.0;
+    double oldpoints = 0.0;
+
+    //1. Cast to cellarstate
+    MOBIPICK_STATE& mobipickState = safe_cast<MOBIPICK_STATE&>(state);
+    MOBIPICK_STATE& oldmobipickState = safe_cast<MOBIPICK_STATE&>(oldstate);
+        
+    //2. Place in Basket (if place and object held WAS good/bad...reward)
+    if(action >= A_PLACE && action < A_PERCEIVE)
+        points = PlacePoints(mobipickState, oldmobipickState.grasping, oldmobipickState.inGrasp.type);
+    //1, 3, 4. Grasp, identify and perceive
+    else{
+        points = ActionPoints(mobipickState, action);
+        if(action >= A_IDENTIFY) oldpoints = ActionPoints(oldmobipickState, action);
+    }
+
     //Update difference for current action
     double result = oldpgs - oldpoints + points;
 
@@ -787,20 +796,23 @@ double MOBIPICK::PGS(STATE& state) const
 void MOBIPICK::GeneratePGS(const STATE& state, const HISTORY& history,
                          vector<int>& legal, const STATUS& status) const
 {
-    static vector<int> acts;
+    static thread_local vector<int> acts;
     acts.clear();
-    STATE * newstate;
     PGSLegal(state, history, acts, status);
     int numLegal = acts.size();
 
     double pgs_values[numLegal];
 
+    //Score actions from the state alone, PGS(state) is the same for all of them
+    if(Knowledge.AnalyticPGS && PGSDeltas(state, acts, pgs_values)){
+        AddBestPGS(acts, pgs_values, legal);
+        return;
+    }
+
+    STATE * newstate;
     STATE * oldstate = Copy(state);
     double pgs_state = PGS(*oldstate);
 
-    int max_p = -1;
-    double max_v = -Infinity;
-
     int observation;
     double reward;
 
@@ -818,20 +830,11 @@ void MOBIPICK::GeneratePGS(const STATE& state, const HISTORY& history,
     }
 
     FreeState(oldstate);
-    max_p = std::distance(pgs_values, max_element(pgs_values, pgs_values+numLegal));
-    max_v = pgs_values[max_p];
-    assert(max_p > -1);
 
     /*
      * Return action with highest PGS, break ties randomly
      * */
-    legal.push_back(acts[max_p]); //Add best action to return vector
-    // Add other maxima
-    for(int i=0; i<numLegal; i++){
-        if(i != max_p && pgs_values[i] == max_v)
-            //if(pgs_values[i] >= 0.5)
-            legal.push_back(acts[i]);
-    }
+    AddBestPGS(acts, pgs_values, legal);
 /*
     cout << "found " << legal.size() << " rollout actions with PGS = " << max_v << endl;
     for(auto a : legal)
@@ -839,6 +842,81 @@ void MOBIPICK::GeneratePGS(const STATE& state, const HISTORY& history,
     cout << endl;*/
 }
 
+/* Expected PGS_RO change of each action, over the outcomes of grasping,
+ * identifying and perceiving (see StepNormal)
+ */
+bool MOBIPICK::PGSDeltas(const STATE& state, const vector<int>& actions, double* deltas) const
+{
+    const MOBIPICK_STATE& mobipickState = safe_cast<const MOBIPICK_STATE&>(state);
+
+    for(int i=0; i < actions.size(); i++){
+        int action = actions[i];
+        double delta = 0.0;
+
+        //1. Grasp: the bonus is counted for what is in grasp after the step
+        if(action >= A_PICK && action < A_IDENTIFY){
+            if(mobipickState.grasping){
+                if( BinEntropyCheck(mobipickState.inGrasp.ProbCyl) && mobipickState.inGrasp.PosKnown ) delta = PGS_pick_pos;
+            }
+            else{
+                int obj = action - A_PICK;
+                for(const auto& t : mobipickState.Tables){
+                    for(const auto& o : t.Objects){
+                        if(o.id != obj) continue;
+                        if(mobipickState.AgentPose == P_TABLE + t.id && o.PosKnown && BinEntropyCheck(o.ProbCyl)){
+                            double p_grasp = o.type == F_CYL ? MOBIPICK::PROB_GRASP : MOBIPICK::PROB_GRASP_OTHER;
+                            delta = p_grasp * PGS_pick_pos;
+                        }
+                    }
+                }
+            }
+        }
+
+        //3. Identify: expected change of the type uncertainty, see Identify
+        else if(action >= A_IDENTIFY && action < A_PLACE){
+            int obj = action - A_IDENTIFY;
+            for(const auto& t : mobipickState.Tables){
+                for(const auto& o : t.Objects){
+                    if(o.id != obj) continue;
+                    if(o.PosKnown && (mobipickState.AgentPose == P_TABLE + t.id || mobipickState.AgentPose == P_NEAR + t.id)){
+                        double efficiency = MOBIPICK::IDENTIFY_ACC;
+                        double pCyl = o.type == F_CYL ? efficiency : 1 - efficiency; //p(O_CYL)
+                        double uncertain = pCyl * !BinEntropyCheck(BinaryPosterior(o.LikelihoodCyl, o.LikelihoodNotCyl, efficiency, true))
+                                        + (1 - pCyl) * !BinEntropyCheck(BinaryPosterior(o.LikelihoodCyl, o.LikelihoodNotCyl, efficiency, false));
+                        delta = PGS_uncertain * (uncertain - !BinEntropyCheck(o.ProbCyl));
+                    }
+                }
+            }
+        }
+
+        //2. Place: deterministic, the pose does not change
+        else if(action >= A_PLACE && action < A_PERCEIVE){
+            delta = PlacePoints(mobipickState, mobipickState.grasping, mobipickState.inGrasp.type);
+        }
+
+        //4. Perceive: objects whose position becomes known, if the table is perceived
+        else if(action >= A_PERCEIVE){
+            int table_id = -1;
+            if(mobipickState.AgentPose >= P_TABLE && mobipickState.AgentPose < P_NEAR) table_id = mobipickState.AgentPose - P_TABLE;
+            if(mobipickState.AgentPose >= P_NEAR && mobipickState.AgentPose < P_NEAR + NumTables) table_id = mobipickState.AgentPose - P_NEAR;
+
+            if(table_id >= 0 && table_id < NumTables){
+                double efficiency = MOBIPICK::PERCEIVE_ACC;
+                for(const auto& o : mobipickState.Tables[table_id].Objects){
+                    if(o.PosKnown) continue;
+                    double probPos = BinaryPosterior(o.LikelihoodPos, o.LikelihoodNotPos, efficiency, true);
+                    double binEntropy = -1*probPos*log2(probPos) - (1-probPos)*log2(1-probPos);
+                    if(binEntropy <= MOBIPICK::IDENTIFY_THRESHOLD)
+                        delta -= efficiency * PGS_uncertain;
+                }
+            }
+        }
+
+        deltas[i] = delta;
+    }
+    return true;
+}
+
 /*
  * Legal actions following PGS policy: avoid actions that do not reduce uncertainty
 */
@@ -872,8 +950,8 @@ void MOBIPICK::PGSLegal(const STATE& state, const HISTORY& history,
         legal.push_back(P_NEAR + table_id); //Navigate to NEAR this table
         
         //Add all pick actions at this table, for active and known objs
-        for(auto o : mobipickState.Tables[table_id].Objects){
-            if(o.active && o.PosKnown) legal.push_back(A_PICK + o.id);
+        for(const auto& o : mobipickState.Tables[table_id].Objects){
+            if(IsActive(o.id) && o.PosKnown) legal.push_back(A_PICK + o.id);
         }
         
         place = true;
@@ -891,9 +969,9 @@ void MOBIPICK::PGSLegal(const STATE& state, const HISTORY& history,
     
     //Identify active and unidentified objects
     if(identify)
-        for(auto t : mobipickState.Tables){
-            for(auto o : t.Objects){
-                if(o.active && o.PosKnown) legal.push_back(A_IDENTIFY + o.id);
+        for(const auto& t : mobipickState.Tables){
+            for(const auto& o : t.Objects){
+                if(IsActive(o.id) && o.PosKnown) legal.push_back(A_IDENTIFY + o.id);
             }
         }
 
@@ -915,10 +993,10 @@ void MOBIPICK::PGSLegal(const STATE& state, const HISTORY& history,
 
         for(auto o : mobipickState.Tables[table_id].Objects){
             //Pick, for active objects with known pos
-            if(o.active && o.PosKnown) legal.push_back(A_PICK + o.id);
+            if(IsActive(o.id) && o.PosKnown) legal.push_back(A_PICK + o.id);
             
             //Identify, for active and unidentified objects with known pos        
-            if(o.active && !BinEntropyCheck(o.ProbCyl) && o.PosKnown)
+            if(IsActive(o.id) && !BinEntropyCheck(o.ProbCyl) && o.PosKnown)
                 legal.push_back(A_IDENTIFY + o.id);
         }
 
@@ -951,14 +1029,14 @@ void MOBIPICK::GenerateLegal(const STATE& state, const HISTORY& history,
     if(mobipickState.AgentPose >= P_TABLE && mobipickState.AgentPose < P_NEAR){
         int table_id = mobipickState.AgentPose - P_TABLE;
         for(auto o : mobipickState.Tables[table_id].Objects){
-            if(o.active && o.PosKnown) legal.push_back(A_PICK + o.id);
+            if(IsActive(o.id) && o.PosKnown) legal.push_back(A_PICK + o.id);
         }
     }
     
     //Identify is always available, but use for active and unidentified objects
     for(auto t : mobipickState.Tables){
         for(auto o : t.Objects){
-            if(o.active && o.PosKnown) legal.push_back(A_IDENTIFY + o.id);
+            if(IsActive(o.id) && o.PosKnown) legal.push_back(A_IDENTIFY + o.id);
         }
     }
 
@@ -98,8 +98,6 @@ public:
             ProbPos = o.ProbPos;
             LikelihoodPos = o.LikelihoodPos;
             LikelihoodNotPos = o.LikelihoodNotPos;
-            
-            active = o.active;
         }
         
         void copy(const MOBIPICK_STATE::OBJECT& o){
@@ -118,8 +116,6 @@ public:
             ProbPos = o.ProbPos;
             LikelihoodPos = o.LikelihoodPos;
             LikelihoodNotPos = o.LikelihoodNotPos;
-            
-            active = o.active;
         }
     };
     
@@ -152,8 +148,6 @@ public:
     };
     BASKET_S Basket;
 
-    void activateFeature(int feature, bool status);
-    
     ~MOBIPICK_STATE();
 };
 
@@ -186,6 +180,9 @@ public:
     //Compute PGS value
     double PGS(STATE& state) const;
     double PGS_RO(STATE& oldstate, STATE& state, int action, double oldpgs) const;  //PGS for rollouts
+    virtual bool PGSDeltas(const STATE& state, const std::vector<int>& actions, double* deltas) const;
+    double ActionPoints(const MOBIPICK_STATE& mobipickState, int action) const; //PGS points of what action affects
+    double PlacePoints(const MOBIPICK_STATE& mobipickState, bool wasGrasping, int graspedType) const;
 
     ///// Incremental refinement /////
     std::vector<FTABLE::F_ENTRY>& getInitialFTable() const {}
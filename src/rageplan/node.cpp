@@ -1,6 +1,7 @@
 #include "node.h"
 #include "history.h"
 #include "utils.h"
+#include <algorithm>
 
 using namespace std;
 
@@ -11,10 +12,41 @@ int QNODE::NumChildren = 0;
 void QNODE::Initialise()
 {
     assert(NumChildren);
-    Children.resize(NumChildren);
-    for (int observation = 0; observation < QNODE::NumChildren; observation++)
-        Children[observation] = 0;
-    AlphaData.AlphaSum.clear();
+    ObsChildren.clear();
+    Locked = false;
+}
+
+static bool ObservationLess(const QNODE::CHILD& child, int observation)
+{
+    return child.Observation < observation;
+}
+
+VNODE* QNODE::Child(int c) const
+{
+    std::vector<CHILD>::const_iterator i_child =
+        std::lower_bound(ObsChildren.begin(), ObsChildren.end(), c, ObservationLess);
+    if (i_child == ObsChildren.end() || i_child->Observation != c)
+        return 0;
+    return i_child->Node;
+}
+
+void QNODE::SetChild(int c, VNODE* vnode)
+{
+    assert(c >= 0 && c < NumChildren);
+    std::vector<CHILD>::iterator i_child =
+        std::lower_bound(ObsChildren.begin(), ObsChildren.end(), c, ObservationLess);
+    if (i_child != ObsChildren.end() && i_child->Observation == c)
+    {
+        if (vnode)
+            i_child->Node = vnode;
+        else
+            ObsChildren.erase(i_child);
+    }
+    else if (vnode)
+    {
+        CHILD child = { c, vnode };
+        ObsChildren.insert(i_child, child);
+    }
 }
 
 void QNODE::DisplayValue(HISTORY& history, int maxDepth, ostream& ostr) const
@@ -24,12 +56,12 @@ void QNODE::DisplayValue(HISTORY& history, int maxDepth, ostream& ostr) const
     if (history.Size() >= maxDepth)
         return;
 
-    for (int observation = 0; observation < NumChildren; observation++)
+    for (int i = 0; i < ObsChildren.size(); i++)
     {
-        if (Children[observation])
+        if (ObsChildren[i].Node)
         {
-            history.Back().Observation = observation;
-            Children[observation]->DisplayValue(history, maxDepth, ostr);
+            history.Back().Observation = ObsChildren[i].Observation;
+            ObsChildren[i].Node->DisplayValue(history, maxDepth, ostr);
         }
     }
 }
@@ -41,28 +73,96 @@ void QNODE::DisplayPolicy(HISTORY& history, int maxDepth, ostream& ostr) const
     if (history.Size() >= maxDepth)
         return;
 
-    for (int observation = 0; observation < NumChildren; observation++)
+    for (int i = 0; i < ObsChildren.size(); i++)
     {
-        if (Children[observation])
+        if (ObsChildren[i].Node)
         {
-            history.Back().Observation = observation;
-            Children[observation]->DisplayPolicy(history, maxDepth, ostr);
+            history.Back().Observation = ObsChildren[i].Observation;
+            ObsChildren[i].Node->DisplayPolicy(history, maxDepth, ostr);
         }
     }
 }
 
 //-----------------------------------------------------------------------------
 
+QNODE_STORE::QNODE_STORE()
+:   NumChunks(0),
+    ChunkUsed(ChunkSize),
+    BlockSize(0),
+    NumBlocks(0)
+{
+}
+
+QNODE_STORE::~QNODE_STORE()
+{
+    DeleteAll();
+}
+
+QNODE_STORE::INDEX QNODE_STORE::Allocate(int blockSize)
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+    if (BlockSize != blockSize)
+    {
+        // Only after DeleteAll, blocks of a different size can't be recycled
+        assert(NumBlocks == 0);
+        assert(blockSize > 0 && blockSize <= ChunkSize);
+        FreeBlocks.clear();
+        ChunkUsed = ChunkSize;
+        BlockSize = blockSize;
+    }
+    NumBlocks++;
+
+    if (!FreeBlocks.empty())
+    {
+        INDEX block = FreeBlocks.back();
+        FreeBlocks.pop_back();
+        return block;
+    }
+
+    // Blocks never straddle chunks
+    if (ChunkUsed + BlockSize > ChunkSize)
+    {
+        assert(NumChunks < MaxChunks);
+        Chunks[NumChunks++] = new QNODE[ChunkSize];
+        ChunkUsed = 0;
+    }
+    INDEX block = ((NumChunks - 1) << ChunkBits) + ChunkUsed;
+    ChunkUsed += BlockSize;
+    return block;
+}
+
+void QNODE_STORE::Free(INDEX block)
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+    FreeBlocks.push_back(block);
+    NumBlocks--;
+}
+
+void QNODE_STORE::DeleteAll()
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+    for (int i = 0; i < NumChunks; i++)
+        delete [] Chunks[i];
+    NumChunks = 0;
+    ChunkUsed = ChunkSize;
+    BlockSize = 0;
+    NumBlocks = 0;
+    FreeBlocks.clear();
+}
+
+//-----------------------------------------------------------------------------
+
 MEMORY_POOL<VNODE> VNODE::VNodePool;
+QNODE_STORE VNODE::QNodes;
 
 int VNODE::NumChildren = 0;
 
 void VNODE::Initialise()
 {
     assert(NumChildren);
-    Children.resize(VNODE::NumChildren);
+    FirstChild = QNodes.Allocate(VNODE::NumChildren);
     for (int action = 0; action < VNODE::NumChildren; action++)
-        Children[action].Initialise();
+        Child(action).Initialise();
 }
 
 VNODE* VNODE::Create()
@@ -76,29 +176,37 @@ void VNODE::Free(VNODE* vnode, const SIMULATOR& simulator)
 {
     //cout << "Belief state free len: " << vnode->BeliefState.GetNumSamples() << endl;
     vnode->BeliefState.Free(simulator);
-    //cout << "VNodePool free" << endl;
-    VNodePool.Free(vnode);
     
     //cout << "Iterate over " << VNODE::NumChildren << " actions and " << QNODE::NumChildren << " obs" << endl;
     
     for (int action = 0; action < VNODE::NumChildren; action++)
-        for (int observation = 0; observation < QNODE::NumChildren; observation++)
-            if (vnode->Child(action).Child(observation))
-                Free(vnode->Child(action).Child(observation), simulator);
+    {
+        std::vector<QNODE::CHILD>& children = vnode->Child(action).Children();
+        for (int i = 0; i < children.size(); i++)
+            if (children[i].Node)
+                Free(children[i].Node, simulator);
+        children.clear();
+    }
+
+    // Only return the node once its children have been read, another search
+    // thread may reuse it straight away
+    //cout << "VNodePool free" << endl;
+    QNodes.Free(vnode->FirstChild);
+    VNodePool.Free(vnode);
 }
 
 void VNODE::FreeAll()
 {
 	VNodePool.DeleteAll();
+	QNodes.DeleteAll();
 }
 
 void VNODE::SetChildren(int count, double value)
 {
     for (int action = 0; action < NumChildren; action++)
     {
-        QNODE& qnode = Children[action];
+        QNODE& qnode = Child(action);
         qnode.Value.Set(count, value);
-        qnode.AMAF.Set(count, value);
     }
 }
 
@@ -110,7 +218,7 @@ void VNODE::DisplayValue(HISTORY& history, int maxDepth, ostream& ostr) const
     for (int action = 0; action < NumChildren; action++)
     {
         history.Add(action);
-        Children[action].DisplayValue(history, maxDepth, ostr);
+        Child(action).DisplayValue(history, maxDepth, ostr);
         history.Pop();
     }
 }
@@ -124,17 +232,17 @@ void VNODE::DisplayPolicy(HISTORY& history, int maxDepth, ostream& ostr) const
     int besta = -1;
     for (int action = 0; action < NumChildren; action++)
     {
-        if (Children[action].Value.GetValue() > bestq)
+        if (Child(action).Value.GetValue() > bestq)
         {
             besta = action;
-            bestq = Children[action].Value.GetValue();
+            bestq = Child(action).Value.GetValue();
         }
     }
 
     if (besta != -1)
     {
         history.Add(besta);
-        Children[besta].DisplayPolicy(history, maxDepth, ostr);
+        Child(besta).DisplayPolicy(history, maxDepth, ostr);
         history.Pop();
     }
 }
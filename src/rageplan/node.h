@@ -4,21 +4,14 @@
 #include "beliefstate.h"
 #include "utils.h"
 #include <iostream>
+#include <thread>
+#include <mutex>
 
 class HISTORY;
 class SIMULATOR;
 class QNODE;
 class VNODE;
 
-//-----------------------------------------------------------------------------
-// Efficient computation of value from alpha vectors
-// Only used for explicit POMDPs
-struct ALPHA
-{
-    std::vector<double> AlphaSum;
-    double MaxValue;
-};
-
 //-----------------------------------------------------------------------------
 
 template<class COUNT>
@@ -44,24 +37,59 @@ public:
         Total += totalReward * weight;
     }
 	 
+    // Thread-safe versions for tree-parallel search
+    void AtomicAdd(double totalReward)
+    {
+        UTILS::AtomicAdd(Count, COUNT(1));
+        UTILS::AtomicAdd(Total, totalReward);
+    }
+
+    // Virtual loss: pretend count visits returned loss each, so that other
+    // threads are steered away from a node while a simulation runs through it
+    void AddVirtualLoss(COUNT count, double loss)
+    {
+        UTILS::AtomicAdd(Count, count);
+        UTILS::AtomicAdd(Total, loss * count);
+    }
+
+    void RemoveVirtualLoss(COUNT count, double loss)
+    {
+        UTILS::AtomicAdd(Count, -count);
+        UTILS::AtomicAdd(Total, -loss * count);
+    }
+
+    // Sum statistics gathered by another search over the same node
+    void Merge(const VALUE<COUNT>& value)
+    {
+        Count += value.Count;
+        Total += value.Total;
+    }
+	 
 	 void AlphaAdd(double totalReward, double alpha = 0.1){
 		  Count += 1;
 		  Total = (1-alpha)*Total + alpha*totalReward;
 	 }
 
+    // Relaxed loads: free on x86, but safe to read while other search threads update
     double GetValue() const
     {
-        return Count == 0 ? Total : Total / Count;
+        COUNT count = GetCount();
+        double total = GetTotal();
+        return count == 0 ? total : total / count;
     }
 	 
 	 double GetTotal() const
     {
-        return Total;
+        double total;
+        __atomic_load(&Total, &total, __ATOMIC_RELAXED);
+        return total;
     }
 
     COUNT GetCount() const
     {
-        return Count;
+        COUNT count;
+        __atomic_load(&Count, &count, __ATOMIC_RELAXED);
+        return count;
     }
 
 private:
@@ -77,14 +105,30 @@ class QNODE
 public:
 
     VALUE<int> Value;
-    VALUE<double> AMAF;
+
+    // Observation children are sparse: only sampled observations are stored,
+    // sorted by observation
+    struct CHILD
+    {
+        int Observation;
+        VNODE* Node;
+    };
 
     void Initialise();
 
-    VNODE*& Child(int c) { return Children[c]; }
-    VNODE* Child(int c) const { return Children[c]; }
-    ALPHA& Alpha() { return AlphaData; }
-    const ALPHA& Alpha() const { return AlphaData; }
+    VNODE* Child(int c) const;
+    void SetChild(int c, VNODE* vnode);
+    int GetNumChildren() const { return ObsChildren.size(); }
+    std::vector<CHILD>& Children() { return ObsChildren; }
+    const std::vector<CHILD>& Children() const { return ObsChildren; }
+
+    // Guards the children while several search threads share the tree
+    void Lock()
+    {
+        while (__atomic_test_and_set(&Locked, __ATOMIC_ACQUIRE))
+            std::this_thread::yield();
+    }
+    void Unlock() { __atomic_clear(&Locked, __ATOMIC_RELEASE); }
 
     void DisplayValue(HISTORY& history, int maxDepth, std::ostream& ostr) const;
     void DisplayPolicy(HISTORY& history, int maxDepth, std::ostream& ostr) const;
@@ -93,12 +137,51 @@ public:
 
 private:
 
-    std::vector<VNODE*> Children;
-    ALPHA AlphaData;
+    bool Locked;
+    std::vector<CHILD> ObsChildren;
 
 friend class VNODE;
 };
 
+//-----------------------------------------------------------------------------
+// Flat storage for the QNODEs of all VNODEs. Each VNODE owns a block of
+// VNODE::NumChildren consecutive QNODEs, addressed by the 32-bit index of
+// the first one. QNODEs live in fixed-size chunks so they never move while
+// the store grows, and freed blocks are recycled with their allocations.
+
+class QNODE_STORE
+{
+public:
+
+    typedef unsigned int INDEX;
+
+    QNODE_STORE();
+    ~QNODE_STORE();
+
+    // Allocate and Free are serialised so the store can be shared by parallel searches
+    INDEX Allocate(int blockSize);
+    void Free(INDEX block);
+    void DeleteAll();
+
+    QNODE& operator[](INDEX index) { return Chunks[index >> ChunkBits][index & (ChunkSize - 1)]; }
+    const QNODE& operator[](INDEX index) const { return Chunks[index >> ChunkBits][index & (ChunkSize - 1)]; }
+
+    int GetNumBlocks() const { return NumBlocks; }
+
+private:
+
+    static const int ChunkBits = 12, ChunkSize = 1 << ChunkBits;
+    static const int MaxChunks = 1 << 16;
+
+    QNODE* Chunks[MaxChunks];
+    int NumChunks;
+    int ChunkUsed; //QNODEs handed out from the last chunk
+    int BlockSize;
+    int NumBlocks;
+    std::vector<INDEX> FreeBlocks;
+    std::mutex Mutex;
+};
+
 //-----------------------------------------------------------------------------
 
 class VNODE : public MEMORY_OBJECT
@@ -112,8 +195,8 @@ public:
     static void Free(VNODE* vnode, const SIMULATOR& simulator);
     static void FreeAll();
 
-    QNODE& Child(int c) { return Children[c]; }
-    const QNODE& Child(int c) const { return Children[c]; }
+    QNODE& Child(int c) { return QNodes[FirstChild + c]; }
+    const QNODE& Child(int c) const { return QNodes[FirstChild + c]; }
     BELIEF_STATE& Beliefs() { return BeliefState; }
     const BELIEF_STATE& Beliefs() const { return BeliefState; }
 
@@ -126,9 +209,10 @@ public:
 
 private:
 
-    std::vector<QNODE> Children;
+    QNODE_STORE::INDEX FirstChild;
     BELIEF_STATE BeliefState;
     static MEMORY_POOL<VNODE> VNodePool;
+    static QNODE_STORE QNodes;
 };
 
 #endif // NODE_H
@@ -168,21 +168,25 @@ bool ROCKSAMPLE::StepPGS(STATE& state, int action,
 	double scale = 10.0;
 	double r = 0.0;
 	double r2 = 0.0;
-	STATE* oldstate = Copy(state);	
+	ROCKSAMPLE_STATE& rockstate = safe_cast<ROCKSAMPLE_STATE&>(state);
+	
+	//Old potential and the old points of PGS_RO, read before the step instead of copying the state
+	r2 = PGS(state);
+	int rock = ActionRock(rockstate, action);
+	double oldpoints = rock >= 0 ? RockPoints(rockstate, rock) : 0.0;
 	
 	bool result = StepNormal(state, action, observation, reward);
 	 // Potential-based reward bonus
 	
 	if(reward != -100){//Not terminal or out of bounds
-		r2 = PGS(*oldstate);
-		r = PGS_RO(*oldstate, state, action, r2);
+		double points = rock >= 0 ? RockPoints(rockstate, rock) : 0.0;
+		r = r2 - oldpoints + points; //As PGS_RO
 		
 		
 		//cout << "reward = " << reward << ", r1 = " << r << ", r2 = " << r2 << endl;
 				
 		reward += scale*r - scale*r2;
 	}
-	FreeState(oldstate);
 	
 	return result;
 }
@@ -391,7 +395,68 @@ bool ROCKSAMPLE::LocalMove(STATE& state, const HISTORY& history,
     return true;
 }
 
+double ROCKSAMPLE::ObservationLikelihood(STATE& state, const HISTORY& history,
+    int stepObs, const STATUS& status) const
+{
+    ROCKSAMPLE_STATE& rockstate = safe_cast<ROCKSAMPLE_STATE&>(state);
+    int action = history.Back().Action;
+    int realObs = history.Back().Observation;
+
+    if (action <= E_SAMPLE)
+        return stepObs == realObs ? 1.0 : 0.0;
+
+    int rock = action - E_SAMPLE - 1;
+    double distance = COORD::EuclideanDistance(rockstate.AgentPos, RockPos[rock]);
+    double efficiency = (1 + pow(2, -distance / HalfEfficiencyDistance)) * 0.5;
+    bool good = realObs == E_GOOD;
+    double likelihood = rockstate.Rocks[rock].Valuable == good ? efficiency : 1.0 - efficiency;
+
+    // Redo the check with the real observation
+    if (stepObs != realObs && likelihood > 0)
+    {
+        double ratio = (1.0 - efficiency) / efficiency;
+        rockstate.Rocks[rock].Count += good ? 2 : -2;
+        rockstate.Rocks[rock].LikelihoodValuable *= good ? 1.0 / ratio : ratio;
+        rockstate.Rocks[rock].LikelihoodWorthless *= good ? ratio : 1.0 / ratio;
+        double denom = (0.5 * rockstate.Rocks[rock].LikelihoodValuable) +
+            (0.5 * rockstate.Rocks[rock].LikelihoodWorthless);
+        rockstate.Rocks[rock].ProbValuable = (0.5 * rockstate.Rocks[rock].LikelihoodValuable) / denom;
+    }
+    return likelihood;
+}
+
 /*** PGS Rollout policy ***/
+/* Rock sampled or checked by action, -1 for moves (sampling does not move the agent) */
+int ROCKSAMPLE::ActionRock(const ROCKSAMPLE_STATE& rockstate, int action) const
+{
+	if(action == E_SAMPLE)
+		return Grid(rockstate.AgentPos);
+	else if (action > E_SAMPLE)
+		return action - E_SAMPLE - 1;
+	return -1;
+}
+
+/* PGS points of a single rock, as counted by PGS */
+double ROCKSAMPLE::RockPoints(const ROCKSAMPLE_STATE& rockstate, int rock) const
+{
+	double points = 0.0;
+	if(rockstate.Rocks[rock].Collected){
+		if (rockstate.Rocks[rock].Valuable){
+			if(rockstate.Rocks[rock].Count)
+				points++; //+1 for sampling rocks w/ good observations
+		}
+		else points--;
+	}
+	else{
+		if(rockstate.Rocks[rock].Measured){			
+			double p = rockstate.Rocks[rock].ProbValuable;
+			double binaryEntropy = -1*p*log2(p) - (1-p)*log2(1-p);			
+			if(binaryEntropy > 0.5) points--;						
+		}
+	}
+	return points;
+}
+
 double ROCKSAMPLE::PGS_RO(STATE& oldstate, STATE& state, int action, double oldpgs) const
 {
 	double points = 0.0;
@@ -401,44 +466,14 @@ double ROCKSAMPLE::PGS_RO(STATE& oldstate, STATE& state, int action, double oldp
 	ROCKSAMPLE_STATE& rockstate = safe_cast<ROCKSAMPLE_STATE&>(state);
 	ROCKSAMPLE_STATE& oldrockstate = safe_cast<ROCKSAMPLE_STATE&>(oldstate);
 	
-	int rock = -1;	
-	if(action == E_SAMPLE)
-		rock = Grid(rockstate.AgentPos);
-	else if (action > E_SAMPLE)
-		rock = action - E_SAMPLE - 1;
+	int rock = ActionRock(rockstate, action);
 	
 	if(rock >= 0){
 		//Points for current state
-		if(rockstate.Rocks[rock].Collected){
-			if (rockstate.Rocks[rock].Valuable){
-				if(rockstate.Rocks[rock].Count)
-					points++; //+1 for sampling rocks w/ good observations
-			}
-			else points--;
-		}
-		else{
-			if(rockstate.Rocks[rock].Measured){			
-				double p = rockstate.Rocks[rock].ProbValuable;
-				double binaryEntropy = -1*p*log2(p) - (1-p)*log2(1-p);			
-				if(binaryEntropy > 0.5) points--;						
-			}
-		}
+		points = RockPoints(rockstate, rock);
 		
 		//Points for previous state
-		if(oldrockstate.Rocks[rock].Collected){
-			if (oldrockstate.Rocks[rock].Valuable){
-				if(oldrockstate.Rocks[rock].Count)
-					oldpoints++; //+1 for sampling rocks w/ good observations
-			}
-			else oldpoints--;
-		}
-		else{
-			if(oldrockstate.Rocks[rock].Measured){			
-				double p = oldrockstate.Rocks[rock].ProbValuable;
-				double binaryEntropy = -1*p*log2(p) - (1-p)*log2(1-p);			
-				if(binaryEntropy > 0.5) oldpoints--;						
-			}
-		}
+		oldpoints = RockPoints(oldrockstate, rock);
 	}
 	//Update difference for current rock
 	double result = oldpgs - oldpoints + points;
@@ -600,7 +635,7 @@ double ROCKSAMPLE::PGS(STATE& state) const
 void ROCKSAMPLE::GeneratePGS(const STATE& state, const HISTORY& history,
     vector<int>& legal, const STATUS& status) const
 {
-	static vector<int> acts;
+	static thread_local vector<int> acts;
 	acts.clear();
 	STATE * newstate;
 	STATE * oldstate = Copy(state);
@@ -54,6 +54,8 @@ public:
 	//Compute PGS value
 	double PGS(STATE& state) const;
 	double PGS_RO(STATE& oldstate, STATE& state, int action, double oldpgs) const;  //PGS for rollouts
+	int ActionRock(const ROCKSAMPLE_STATE& rockstate, int action) const; //Rock affected by action
+	double RockPoints(const ROCKSAMPLE_STATE& rockstate, int rock) const; //PGS points of one rock
 	/********************************/
 
     void GenerateLegal(const STATE& state, const HISTORY& history,
@@ -62,6 +64,8 @@ public:
         std::vector<int>& legal, const STATUS& status) const;
     virtual bool LocalMove(STATE& state, const HISTORY& history,
         int stepObservation, const STATUS& status) const;
+    virtual double ObservationLikelihood(STATE& state, const HISTORY& history,
+        int stepObservation, const STATUS& status) const;
 
     virtual void DisplayBeliefs(const BELIEF_STATE& beliefState,
         std::ostream& ostr) const;
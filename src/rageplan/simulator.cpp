@@ -7,7 +7,8 @@ SIMULATOR::KNOWLEDGE::KNOWLEDGE()
 :   TreeLevel(LEGAL),
     RolloutLevel(LEGAL),
     SmartTreeCount(10),
-    SmartTreeValue(1.0)
+    SmartTreeValue(1.0),
+    AnalyticPGS(false)
 {
 }
 
@@ -37,6 +38,19 @@ SIMULATOR::~SIMULATOR()
 { 
 }
 
+void SIMULATOR::ActivateFeature(int feature, bool status) const
+{
+    if (feature < 0)
+        return;
+    if (feature >= InactiveFeatures.size())
+    {
+        if (status)
+            return;
+        InactiveFeatures.resize(feature + 1, false);
+    }
+    InactiveFeatures[feature] = !status;
+}
+
 void SIMULATOR::Validate(const STATE& state) const 
 { 
 }
@@ -47,6 +61,12 @@ bool SIMULATOR::LocalMove(STATE& state, const HISTORY& history,
     return true;
 }
 
+double SIMULATOR::ObservationLikelihood(STATE& state, const HISTORY& history,
+    int stepObs, const STATUS& status) const
+{
+    return stepObs == history.Back().Observation ? 1.0 : 0.0;
+}
+
 void SIMULATOR::GenerateRelevant(const STATE& state, const HISTORY& history,
     std::vector<int>& actions, const STATUS& status) const
 {
@@ -85,6 +105,19 @@ void SIMULATOR::GeneratePGS(const STATE& state, const HISTORY& history,
 {
 }
 
+void SIMULATOR::AddBestPGS(const std::vector<int>& actions, const double* values,
+    std::vector<int>& legal)
+{
+    int numLegal = actions.size();
+    int max_p = std::distance(values, std::max_element(values, values + numLegal));
+    double max_v = values[max_p];
+
+    legal.push_back(actions[max_p]);
+    for (int i = 0; i < numLegal; i++)
+        if (i != max_p && values[i] == max_v)
+            legal.push_back(actions[i]);
+}
+
 void SIMULATOR::PGSLegal(const STATE& state, const HISTORY& history,
     std::vector<int>& actions, const STATUS& status) const
 {
@@ -93,7 +126,7 @@ void SIMULATOR::PGSLegal(const STATE& state, const HISTORY& history,
 int SIMULATOR::SelectRandom(const STATE& state, const HISTORY& history,
     const STATUS& status) const
 {
-    static vector<int> actions;
+    static thread_local vector<int> actions;
 
     if (Knowledge.RolloutLevel >= KNOWLEDGE::PGS)
     {
@@ -128,7 +161,7 @@ int SIMULATOR::SelectRandom(const STATE& state, const HISTORY& history,
 void SIMULATOR::Prior(const STATE* state, const HISTORY& history,
     VNODE* vnode, const STATUS& status) const
 {
-    static vector<int> actions;
+    static thread_local vector<int> actions;
     
     if (Knowledge.TreeLevel == KNOWLEDGE::PURE || state == 0)
     {
@@ -150,7 +183,6 @@ void SIMULATOR::Prior(const STATE* state, const HISTORY& history,
             int a = *i_action;
             QNODE& qnode = vnode->Child(a);
             qnode.Value.Set(0, 0);
-            qnode.AMAF.Set(0, 0);
         }
     }
 	 //TODO: review and possibly improve node initialization.  Eg. initial values.  Also, must ALL actions be pre-added?
@@ -164,7 +196,6 @@ void SIMULATOR::Prior(const STATE* state, const HISTORY& history,
             int a = *i_action;
             QNODE& qnode = vnode->Child(a);
             qnode.Value.Set(0, 0);
-            qnode.AMAF.Set(0, 0);
         }
     }
 	 else if (Knowledge.TreeLevel >= KNOWLEDGE::SMART)
@@ -177,7 +208,6 @@ void SIMULATOR::Prior(const STATE* state, const HISTORY& history,
             int a = *i_action;
             QNODE& qnode = vnode->Child(a);
             qnode.Value.Set(Knowledge.SmartTreeCount, Knowledge.SmartTreeValue);
-            qnode.AMAF.Set(Knowledge.SmartTreeCount, Knowledge.SmartTreeValue);
         }    
     }
 	 
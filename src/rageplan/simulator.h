@@ -16,7 +16,7 @@ class BELIEF_STATE;
 class STATE : public MEMORY_OBJECT
 {
 public:
-	virtual void activateFeature(int feature, bool status){}
+    int RefCount; //No. of belief states holding this particle, see BELIEF_STATE
 };
 
 struct PROBLEM_PARAMS : MEMORY_OBJECT{
@@ -45,6 +45,7 @@ public:
         int TreeLevel; //NODE Initialization policy -- e.g. for preferred actions
         int SmartTreeCount; // If TreeLevel > SMART, use SmartCount
         double SmartTreeValue; // If TreeLevel > SMART, use SmartValue
+        bool AnalyticPGS; // PGS rollouts score actions with PGSDeltas instead of simulating them
         
         int Level(int phase) const
         {
@@ -77,6 +78,7 @@ public:
         
         int Phase;
         int Particles;
+        std::vector<double> ObsConfidence; //Confidence of each bit of the real observation, from perception (empty = exact)
     };
 	 
 	 /////////////////////////
@@ -84,6 +86,16 @@ public:
 	 bool useFtable = false;
 	 virtual std::vector<FTABLE::F_ENTRY>& getInitialFTable() const {}
 	 virtual void initializeFTable(FTABLE& ftable) const {}
+
+	 // Features switched off by the F-table are skipped in Step, rollouts and
+	 // action generation. One mask for the whole search, not a flag per particle.
+	 // Only switch features between searches, see InactiveFeatures
+	 void ActivateFeature(int feature, bool status) const;
+	 void ActivateAllFeatures() const { InactiveFeatures.clear(); }
+	 bool IsActive(int feature) const
+	 {
+	     return feature < 0 || feature >= InactiveFeatures.size() || !InactiveFeatures[feature];
+	 }
 	 ////////////////////////
 	 
     SIMULATOR();
@@ -111,6 +123,35 @@ public:
     virtual bool LocalMove(STATE& state, const HISTORY& history,
         int stepObs, const STATUS& status) const;
 
+    // Likelihood of the real observation (last in history) in state, which was
+    // just stepped with the last action and generated stepObs. Observation
+    // dependent state variables are conditioned on the real observation.
+    // Default is rejection: 1 if stepObs matches, 0 otherwise.
+    // Values must be at most 1, see MCTS::FilterBeliefs
+    virtual double ObservationLikelihood(STATE& state, const HISTORY& history,
+        int stepObs, const STATUS& status) const;
+
+    // Particle deduplication: hash and equality over every state variable.
+    // A hash of 0 means the simulator cannot compare states (default)
+    virtual std::size_t Hash(const STATE& state) const { return 0; }
+    virtual bool Equal(const STATE& state1, const STATE& state2) const { return false; }
+
+    // Factored beliefs: redraw state variables from marginals the simulator
+    // keeps within the state. This approximates the joint belief, it saves
+    // particles at a cost in return. Returns false if there are none
+    virtual bool SampleFactors(STATE& state) const { return false; }
+
+    // Packed particles (BELIEF_STATE::Pack): variables that change are written
+    // as bit fields, probabilities as doubles. Unpack overwrites a copy of a
+    // particle of the same belief, which supplies the fixed ones. Returns
+    // false if the simulator cannot pack (default)
+    virtual bool Pack(const STATE& state, UTILS::BIT_WRITER& bits, std::vector<double>& probs) const { return false; }
+    virtual void Unpack(UTILS::BIT_READER& bits, const double* probs, STATE& state) const { }
+
+    // Bin of state for adaptive particle counts (KLD-sampling), only the
+    // hidden variables that matter should count. 0 = no discretisation
+    virtual std::size_t Discretise(const STATE& state) const { return Hash(state); }
+
     // Use domain knowledge to assign prior value and confidence to actions
     // Should only use fully observable state variables
     void Prior(const STATE* state, const HISTORY& history, VNODE* vnode,
@@ -138,6 +179,11 @@ public:
     // Generate set of PGS actions
     virtual void GeneratePGS(const STATE& state, const HISTORY& history,
                                    std::vector<int>& actions, const STATUS& status) const;
+    // Expected change of the PGS score for each action, computed from state
+    // without simulating the step (see KNOWLEDGE::AnalyticPGS).
+    // Returns false if the simulator cannot score actions this way
+    virtual bool PGSDeltas(const STATE& state, const std::vector<int>& actions,
+                           double* deltas) const { return false; }
 
     // Textual display
     virtual void DisplayBeliefs(const BELIEF_STATE& beliefState, 
@@ -167,6 +213,18 @@ protected:
     double Discount, RewardRange;
     double fDiscount;
     KNOWLEDGE Knowledge;
+
+    // Add the actions with the highest PGS value to legal, first maximum first
+    static void AddBestPGS(const std::vector<int>& actions, const double* values,
+                           std::vector<int>& legal);
+
+private:
+
+    // Bitset, empty while all features are on. Search threads (parallel
+    // workers, the ponder thread) read it without a lock, so it may only be
+    // written between searches: by the MCTS constructor, and by MCTS::Update
+    // (beliefRevision) after StopPondering
+    mutable std::vector<bool> InactiveFeatures;
 };
 
 #endif // SIMULATOR_H
@@ -3,6 +3,9 @@
 namespace UTILS
 {
 
+thread_local bool ThreadSeeded = false;
+thread_local unsigned int ThreadState = 0;
+
 void UnitTest()
 {
     assert(Sign(+10) == +1);
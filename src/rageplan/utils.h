@@ -8,6 +8,8 @@
 #include "coord.h"
 #include "memorypool.h"
 #include <algorithm>
+#include <functional>
+#include <stdint.h>
 
 #define LargeInteger 1000000
 #define Infinity 1e+10
@@ -22,6 +24,37 @@
 namespace UTILS
 {
 
+// Per-thread generator state for parallel search.
+// Threads that were never seeded (e.g. the main thread) keep using rand().
+extern thread_local bool ThreadSeeded;
+extern thread_local unsigned int ThreadState;
+
+inline void ThreadRandomSeed(unsigned int seed)
+{
+    ThreadState = seed;
+    ThreadSeeded = true;
+}
+
+inline int Rand()
+{
+    return ThreadSeeded ? rand_r(&ThreadState) : rand();
+}
+
+// Lock-free accumulation for tree-parallel search
+inline void AtomicAdd(int& var, int value)
+{
+    __atomic_fetch_add(&var, value, __ATOMIC_RELAXED);
+}
+
+inline void AtomicAdd(double& var, double value)
+{
+    double old, sum;
+    __atomic_load(&var, &old, __ATOMIC_RELAXED);
+    do
+        sum = old + value;
+    while (!__atomic_compare_exchange(&var, &old, &sum, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
 inline int Sign(int x)
 {
     return (x > 0) - (x < 0);
@@ -29,17 +62,24 @@ inline int Sign(int x)
 
 inline int Random(int max)
 {
-    return rand() % max;
+    return Rand() % max;
 }
 
 inline int Random(int min, int max)
 {
-    return rand() % (max - min) + min;
+    return Rand() % (max - min) + min;
 }
 
 inline double RandomDouble(double min, double max)
 {
-    return (double) rand() / RAND_MAX * (max - min) + min;
+    return (double) Rand() / RAND_MAX * (max - min) + min;
+}
+
+// Mix value into a running hash (as boost::hash_combine), for simulator state hashes
+template<class T>
+inline void HashCombine(std::size_t& seed, const T& value)
+{
+    seed ^= std::hash<T>()(value) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
 }
 
 inline void RandomSeed(int seed)
@@ -49,7 +89,7 @@ inline void RandomSeed(int seed)
 
 inline bool Bernoulli(double p)
 {
-    return rand() < p * RAND_MAX;
+    return Rand() < p * RAND_MAX;
 }
 
 inline bool Near(double x, double y, double tol)
@@ -57,6 +97,111 @@ inline bool Near(double x, double y, double tol)
     return fabs(x - y) <= tol;
 }
 
+// Binary estimate 0.5 lTrue / (0.5 lTrue + 0.5 lFalse) after one more reading
+// of accuracy efficiency, that reports true (positive) or false
+inline double BinaryPosterior(double lTrue, double lFalse, double efficiency, bool positive)
+{
+    lTrue *= positive ? efficiency : 1 - efficiency;
+    lFalse *= positive ? 1 - efficiency : efficiency;
+    return (0.5 * lTrue) / ((0.5 * lTrue) + (0.5 * lFalse));
+}
+
+// Bit fields packed into 64-bit words (see SIMULATOR::Pack). Each writer
+// starts a new word, fields never straddle two words
+class BIT_WRITER
+{
+public:
+
+    BIT_WRITER(std::vector<uint64_t>& words) : Words(words), Bit(64) { }
+
+    void Put(uint64_t value, int bits)
+    {
+        assert(bits > 0 && bits <= 64 && (bits == 64 || value >> bits == 0));
+        if (Bit + bits > 64)
+        {
+            Words.push_back(0);
+            Bit = 0;
+        }
+        Words.back() |= value << Bit;
+        Bit += bits;
+    }
+    void PutInt(int value) { Put((uint32_t) value, 32); }
+
+private:
+
+    std::vector<uint64_t>& Words;
+    int Bit; //Next free bit of the last word
+};
+
+class BIT_READER
+{
+public:
+
+    BIT_READER(const uint64_t* words) : Words(words - 1), Bit(64) { }
+
+    uint64_t Get(int bits)
+    {
+        if (Bit + bits > 64)
+        {
+            Words++;
+            Bit = 0;
+        }
+        uint64_t value = *Words >> Bit;
+        Bit += bits;
+        return bits == 64 ? value : value & ((uint64_t(1) << bits) - 1);
+    }
+    int GetInt() { return (int32_t) Get(32); }
+
+private:
+
+    const uint64_t* Words;
+    int Bit;
+};
+
+// Vector with inline storage for at most N items. Trivially copyable when T
+// is, so states built from these copy as one block without allocating
+template<class T, int N>
+class FIXED_VECTOR
+{
+public:
+
+    FIXED_VECTOR() : Count(0) { }
+
+    int size() const { return Count; }
+    bool empty() const { return Count == 0; }
+    void clear() { Count = 0; }
+    void resize(int count, const T& value = T())
+    {
+        assert(count <= N);
+        for (int i = Count; i < count; i++)
+            Items[i] = value;
+        Count = count;
+    }
+    void push_back(const T& item)
+    {
+        assert(Count < N);
+        Items[Count++] = item;
+    }
+
+    T& operator[](int i) { return Items[i]; }
+    const T& operator[](int i) const { return Items[i]; }
+    T& back() { return Items[Count - 1]; }
+    T* begin() { return Items; }
+    T* end() { return Items + Count; }
+    const T* begin() const { return Items; }
+    const T* end() const { return Items + Count; }
+
+    bool operator==(const FIXED_VECTOR& v) const
+    {
+        return Count == v.Count && std::equal(begin(), end(), v.begin());
+    }
+
+private:
+
+    T Items[N];
+    int Count;
+};
+
 inline bool CheckFlag(int flags, int bit) { return (flags & (1 << bit)) != 0; }
 
 inline void SetFlag(int& flags, int bit) { flags = (flags | (1 << bit)); }
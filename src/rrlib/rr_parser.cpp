@@ -89,6 +89,8 @@ namespace RR_PARSER{
                 cl.simDoubles = stoi(value);
             else if(param == "timeout")
                 cl.timeout = stoi(value);
+            else if(param == "planningTime")
+                cl.planningTime = stof(value);
             else if(param == "verbose")
                 cl.verbose = stoi(value);
             else if(param == "treeKnowledge")
@@ -97,6 +99,36 @@ namespace RR_PARSER{
                 cl.rolloutKnowledge = stoi(value);
             else if(param == "ire")
                 cl.fTable = stoi(value);
+            else if(param == "threads")
+                cl.threads = stoi(value);
+            else if(param == "treeParallel")
+                cl.treeParallel = stoi(value);
+            else if(param == "ponder")
+                cl.ponder = stoi(value);
+            else if(param == "reuseTree")
+                cl.reuseTree = stoi(value);
+            else if(param == "wideningK")
+                cl.wideningK = stof(value);
+            else if(param == "wideningAlpha")
+                cl.wideningAlpha = stof(value);
+            else if(param == "earlyStop")
+                cl.earlyStop = stof(value);
+            else if(param == "weightedBeliefs")
+                cl.weightedBeliefs = stoi(value);
+            else if(param == "compactBeliefs")
+                cl.compactBeliefs = stoi(value);
+            else if(param == "kldError")
+                cl.kldError = stof(value);
+            else if(param == "filterParticles")
+                cl.filterParticles = stoi(value);
+            else if(param == "filterTime")
+                cl.filterTime = stof(value);
+            else if(param == "factoredParticles")
+                cl.factoredParticles = stoi(value);
+            else if(param == "packBeliefs")
+                cl.packBeliefs = stoi(value);
+            else if(param == "analyticPGS")
+                cl.analyticPGS = stoi(value);
             else                
                 cout << "\tWarning: \"" << param << "\" is not a valid parameter." << endl;
         }
@@ -342,6 +374,11 @@ namespace RR_PARSER{
 
         cout << "Problem parsed. Objects = " << ap.n_objs << ", Types = " << ap.n_types << ", Parts = " << ap.n_parts << endl;
 
+        if(ap.n_parts > HOTEL_MAX_PARTS){
+            cout << "At most " << HOTEL_MAX_PARTS << " parts are supported" << endl;
+            return false;
+        }
+
         return true;
     }
 }
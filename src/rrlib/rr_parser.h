@@ -27,10 +27,26 @@ namespace RR_PARSER{
         string outputFile = "output.txt";
         int simDoubles;
         int timeout = 1000;        
+        double planningTime = 0;
         int verbose = 0;
         int treeKnowledge = 1;
         int rolloutKnowledge = 1;
         bool fTable = 0;
+        int threads = 1;
+        bool treeParallel = 0;
+        bool ponder = 1;
+        bool reuseTree = 0;
+        double wideningK = 0;
+        double wideningAlpha = 0.5;
+        double earlyStop = 0;
+        bool weightedBeliefs = 0;
+        bool compactBeliefs = 0;
+        double kldError = 0;
+        int filterParticles = 0;
+        double filterTime = 0;
+        int factoredParticles = 0;
+        bool packBeliefs = 0;
+        bool analyticPGS = 0;
     };
 
     void parseCommandLine(char ** argv, int argc, COMMAND_LINE& cl);
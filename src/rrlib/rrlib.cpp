@@ -9,7 +9,6 @@ RRLIB::RRLIB(const SIMULATOR& sim, const std::string& outputFile, RUN_PARAMS& Ru
     if (runParams.autoExploration){
         searchParams.ExplorationConstant = sim.GetRewardRange();
     }
-    MCTS::InitFastUCB(searchParams.ExplorationConstant);
             
     Results.undiscountedReturn = 0.0;
     Results.discountedReturn = 0.0;
@@ -18,12 +17,14 @@ RRLIB::RRLIB(const SIMULATOR& sim, const std::string& outputFile, RUN_PARAMS& Ru
     searchParams.MaxDepth = POMDP.GetHorizon(runParams.accuracy, runParams.undiscountedHorizon);
     searchParams.NumSimulations = 1 << runParams.simDoubles;
     searchParams.NumStartStates = 1 << runParams.simDoubles;
+    searchParams.TimeOut = runParams.planningTime;
 
     if (runParams.simDoubles + runParams.transformDoubles >= 0)
         searchParams.NumTransforms = 1 << (runParams.simDoubles + runParams.transformDoubles);
     else
         searchParams.NumTransforms = 1;
     searchParams.MaxAttempts = searchParams.NumTransforms * runParams.transformAttempts;
+    searchParams.MaxPonderSimulations = searchParams.NumSimulations; //At most one search worth, SelectAction subtracts it from the next
 
 
     //Initialize MCTS search class with planning POMDP + params
@@ -37,25 +38,45 @@ void RRLIB::Init(){
 
 }
 
-int RRLIB::PlanAction(int numSims, double timeout){    
+int RRLIB::PlanAction(int numSims, double timeout){
+    int simsDone;
+    return PlanAction(numSims, timeout, simsDone);
+}
+
+int RRLIB::PlanAction(int numSims, double timeout, int& simsDone){
     //cout << "MCTS select action" << endl;
-    int action = mcts->SelectAction(); ///MCTS search
+    int action = mcts->SelectAction(numSims, timeout); ///MCTS search, anytime if a deadline is set
+    simsDone = mcts->GetNumSimulations();
 
     if(searchParams.Verbose >= 1){
-        cout << "Selected action: " << endl;
+        cout << "Selected action after " << simsDone << " simulations (" << mcts->GetSimulationsPerSecond() << " sims/s";
+        if(mcts->GetSimulationsSaved() > 0)
+            cout << ", " << mcts->GetSimulationsSaved() << " saved by early stopping";
+        cout << "): " << endl;
         POMDP.DisplayAction(action, cout);
     }
 
     return action;
 }
 
+void RRLIB::StartPondering(int action){
+    if(runParams.ponder)
+        mcts->StartPondering(action);
+}
+
 int RRLIB::Update(int action, int observation, double reward, bool terminal){
+    return Update(action, observation, reward, terminal, std::vector<double>());
+}
+
+int RRLIB::Update(int action, int observation, double reward, bool terminal, const std::vector<double>& confidence){
 
     double undiscountedReturn = 0.0;
     double discountedReturn = 0.0;
     double discount = 1.0;    
     bool outOfParticles = false;
 
+    mcts->StopPondering(); //Update would stop it too, but not on terminal steps
+
     Results.Reward.Add(reward);
     Results.undiscountedReturn += reward;
     Results.discountedReturn += reward * Results.discount;
@@ -79,7 +100,7 @@ int RRLIB::Update(int action, int observation, double reward, bool terminal){
 
     }
     //cout << "Updating..." << endl;
-    outOfParticles = !mcts->Update(action, observation, reward);       
+    outOfParticles = !mcts->Update(action, observation, reward, confidence);
     //cout << "Finished update" << endl;
     
     if (outOfParticles)
@@ -7,7 +7,10 @@
     The main steps consist of:
         1. Create instance by providing created POMDP, output file, execution and MCTS parameters.
         2. Plan for the next action using PlanAction. Returns action.
+           Search stops after numSims simulations or timeout seconds, whichever comes first (<= 0 uses the search params).
         3. When action is executed onboard robot and results perceived, run Update with action, observation, reward and indicate if a terminal state was reached
+           Optionally, call StartPondering(action) while the action executes to keep searching below it in the background.
+           If perception reports its accuracy, pass it as confidence so noisy observations weight particles instead of rejecting them.
         4. Plan again until terminal condition is met.
 
     By:
@@ -37,6 +40,8 @@ class RRLIB{
         struct RUN_PARAMS{
             int simSteps = 1000;
             double timeout = 3600;
+            double planningTime = 0; //Per-decision search deadline in seconds (0 = no deadline)
+            bool ponder = true; //Search in the background while actions execute
             double discount;            
             bool autoExploration = true;
             int simDoubles;
@@ -59,8 +64,11 @@ class RRLIB{
         
         void Init();
         int PlanAction(int numSims, double timeout); //Plan using mcts w/ POMDP. Return action.
+        int PlanAction(int numSims, double timeout, int& simsDone); //Same as above, also returns no. of simulations completed
+        void StartPondering(int action); //Keep searching below action while it executes, until Update
         double Reward(int action, int observation); //Calculate reward from planned action and perceived observation.
         int Update(int action, int observation, double reward, bool terminal); //Update mcts/POMDP. Observation and reward come from previous steps
+        int Update(int action, int observation, double reward, bool terminal, const std::vector<double>& confidence); //Same as above, weighting particles by the perception confidence of each observation bit
         RESULTS& getStatistics();
         void InteractiveRun();
 
@@ -26,7 +26,7 @@ RRLIB_HOTEL::RRLIB_HOTEL(string inputfile, string outputfile, int timeout, int s
 
     n_parts = worker_params.n_parts;
 
-    POMDP = new HOTEL_ROBOT(problem_params, worker_params);
+    POMDP = HOTEL_ROBOT::Create(problem_params, worker_params);
     POMDP->SetKnowledge(knowledge);
 
     //Display problem information/setup
@@ -71,12 +71,28 @@ RRLIB_HOTEL::RRLIB_HOTEL(char ** argv, int argc){
 
     runParams.timeout = cl.timeout;
     runParams.simDoubles = cl.simDoubles;
+    runParams.planningTime = cl.planningTime;
+    runParams.ponder = cl.ponder;
 
     searchParams.Verbose = cl.verbose;
     searchParams.useFtable = cl.fTable;
+    searchParams.NumThreads = cl.threads;
+    searchParams.TreeParallel = cl.treeParallel;
+    searchParams.ReuseTree = cl.reuseTree || cl.ponder; //Pondering grows the kept subtree
+    searchParams.WideningConstant = cl.wideningK;
+    searchParams.WideningExponent = cl.wideningAlpha;
+    searchParams.EarlyStopDelta = cl.earlyStop;
+    searchParams.WeightedBeliefs = cl.weightedBeliefs;
+    searchParams.CompactBeliefs = cl.compactBeliefs;
+    searchParams.KLDError = cl.kldError;
+    searchParams.FilterParticles = cl.filterParticles;
+    searchParams.FilterTimeOut = cl.filterTime;
+    searchParams.FactoredParticles = cl.factoredParticles;
+    searchParams.PackBeliefs = cl.packBeliefs;
 
     knowledge.TreeLevel = cl.treeKnowledge;
     knowledge.RolloutLevel = cl.rolloutKnowledge;
+    knowledge.AnalyticPGS = cl.analyticPGS;
 
     HOTEL_PARAMS worker_params;
     HOTEL_ROBOT_PARAMS problem_params;
@@ -102,12 +118,14 @@ RRLIB_HOTEL::RRLIB_HOTEL(char ** argv, int argc){
     n_parts = worker_params.n_parts;
 
     //TODO: we could maintain a Simulator * POMDP ptr instead and initialize accordingly depending on the problem
-    POMDP = new HOTEL_ROBOT(problem_params, worker_params);
+    POMDP = HOTEL_ROBOT::Create(problem_params, worker_params);
     POMDP->SetKnowledge(knowledge);
 
     //Display problem information/setup
     cout << "Running: " << problem_params.description << endl;
     cout << "No. of sims: " << (1 << runParams.simDoubles) << endl;
+    if(runParams.planningTime > 0)
+        cout << "Planning time: " << runParams.planningTime << " s." << endl;
     cout << "Policy: ";
     if(knowledge.RolloutLevel == 1) cout << "Random";
     else if(knowledge.RolloutLevel >= 3) cout << "PGS";
@@ -211,7 +229,10 @@ int RRLIB_HOTEL::ROSRun(int argc, char ** argv){
     do{
         //1. Plan and select action
         actionType = UNKNOWN_ACTION;
-        int action = rr->PlanAction(0, 0); //or e.g. POMDP->A_PERCEIVE to force "observe worker"
+        std::vector<double> confidence; //Accuracy of perceived observations, manipulation outcomes are exact
+        int simsDone = 0;
+        int action = rr->PlanAction(0, 0, simsDone); //Bounded by planningTime if set. Or e.g. POMDP->A_PERCEIVE to force "observe worker"
+        ROS_INFO("Planned with %i simulations", simsDone);
         
         //Display Action
         if(use_mockup_GUI){
@@ -274,6 +295,8 @@ int RRLIB_HOTEL::ROSRun(int argc, char ** argv){
             if(perceptionClient.call(srv_msg)){
                 bool terminalObs = false;
                 GetObsFromMSG(srv_msg, observation, accuracy, terminalObs);
+                if(accuracy > 0 && accuracy <= 1)
+                    confidence.assign(1, accuracy); //Same accuracy for every bit
                 //Display observation
                 DisplayObservation(observation, action);
                 if(terminalObs){
@@ -287,6 +310,7 @@ int RRLIB_HOTEL::ROSRun(int argc, char ** argv){
         }
         else if (actionType == MANIPULATION_ACTION){
             ROS_INFO("Attempting to execute action on Mobipick...");
+            rr->StartPondering(action); //Plan ahead while the robot is busy, stopped in Update
             actionClient.sendGoalAndWait(goal);
             ROS_INFO("Action finished on Mobipick.");
             tables_demo_planning::PlanAndExecuteTasksResult result = *(actionClient.getResult());
@@ -319,8 +343,8 @@ int RRLIB_HOTEL::ROSRun(int argc, char ** argv){
         //4. Update POMDP with observation and reward
         // Technically, the POMDP is updated with only action and observation.
         // Reward is for performance monitoring
-        // Observation accuracy is not really necessary; we assume the model is correct.
-        int status = rr->Update(action, observation, reward, terminal); //status = e.g. out of particles, etc.
+        // Observation accuracy weights particles, so noisy part arrays do not reject them all.
+        int status = rr->Update(action, observation, reward, terminal, confidence); //status = e.g. out of particles, etc.
 
         steps++;
     }while(!terminal && ros::ok());